@@ -7,6 +7,7 @@
 #include <hash.h>
 #include <random.h>
 #include <uint256.h>
+#include <crypto/argon2m.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -75,6 +76,23 @@ static void SipHash_32b(benchmark::State& state)
     }
 }
 
+static void Argon2mReference(benchmark::State& state)
+{
+    std::vector<uint8_t> in(ARGON2M_INPUT_SIZE, 0);
+    while (state.KeepRunning()) {
+        Argon2mReferenceHash(in.data(), in.data());
+    }
+}
+
+static void Argon2m(benchmark::State& state)
+{
+    Argon2mAutoDetect();
+    std::vector<uint8_t> in(ARGON2M_INPUT_SIZE, 0);
+    while (state.KeepRunning()) {
+        Argon2mHash(in.data(), in.data());
+    }
+}
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -99,5 +117,7 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(Argon2mReference, 1800);
+BENCHMARK(Argon2m, 2400);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
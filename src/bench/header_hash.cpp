@@ -0,0 +1,69 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/block.h>
+#include <random.h>
+
+#include <vector>
+
+// Number of headers hashed per iteration, roughly the cost of validating a
+// small headers message.
+static const size_t HEADERS_PER_ITER = 100;
+
+static std::vector<CBlockHeader> MakeHeaders()
+{
+    FastRandomContext rng(true);
+    std::vector<CBlockHeader> headers(HEADERS_PER_ITER);
+    for (CBlockHeader& header : headers) {
+        header.hashPrevBlock = rng.rand256();
+        header.hashMerkleRoot = rng.rand256();
+        header.nTime = rng.rand32();
+        header.nBits = 0x1e0fffff;
+        header.nNonce = rng.rand32();
+    }
+    return headers;
+}
+
+// Every call runs argon2m, which is what every GetHash() call used to cost.
+static void HeaderHashArgon2(benchmark::State& state)
+{
+    const std::vector<CBlockHeader> headers = MakeHeaders();
+    while (state.KeepRunning()) {
+        for (const CBlockHeader& header : headers)
+            header.GetUncachedHash();
+    }
+}
+
+// Fresh header objects with identical bytes, as when the same headers are
+// relayed by several peers: served from the shared header hash cache.
+static void HeaderHashSharedCache(benchmark::State& state)
+{
+    const std::vector<CBlockHeader> headers = MakeHeaders();
+    for (const CBlockHeader& header : headers)
+        header.GetHash();
+
+    while (state.KeepRunning()) {
+        for (const CBlockHeader& header : headers) {
+            CBlockHeader copy = header;
+            copy.hashMemo.Clear();
+            copy.GetHash();
+        }
+    }
+}
+
+// Repeated calls on the same object, as validation does: served from the
+// per-object memo.
+static void HeaderHashMemo(benchmark::State& state)
+{
+    const std::vector<CBlockHeader> headers = MakeHeaders();
+    while (state.KeepRunning()) {
+        for (const CBlockHeader& header : headers)
+            header.GetHash();
+    }
+}
+
+BENCHMARK(HeaderHashArgon2, 200);
+BENCHMARK(HeaderHashSharedCache, 20 * 1000);
+BENCHMARK(HeaderHashMemo, 40 * 1000);
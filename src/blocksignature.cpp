@@ -4,11 +4,21 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <blocksignature.h>
+#include <script/saltedsigcache.h>
 #include <script/signingprovider.h>
 #include <validation.h>
 
 typedef std::vector<uint8_t> valtype;
 
+namespace {
+/**
+ * Valid block signature cache, so that the signature of a block checked by
+ * ProcessNewBlock or TestBlockValidity is not verified again when the block
+ * is connected.
+ */
+CSaltedSignatureCache<> blockSignatureCache(BLOCK_SIGNATURE_CACHE_BYTES);
+} // namespace
+
 bool GetKeyIDFromUTXO(const CTxOut& txout, CKeyID& keyID)
 {
     std::vector<valtype> vSolutions;
@@ -50,7 +60,7 @@ bool SignBlock(CBlock& block, const SigningProvider& keystore)
     return true;
 }
 
-bool CheckBlockSignature(const CBlock& block)
+bool CheckBlockSignature(const CBlock& block, bool fCacheStore)
 {
     if (block.IsProofOfWork())
         return block.vchBlockSig.empty();
@@ -72,6 +82,14 @@ bool CheckBlockSignature(const CBlock& block)
     if (!pubkey.IsValid())
         return error("%s: invalid pubkey %s", __func__, HexStr(pubkey));
 
-    return pubkey.Verify(block.GetHash(), block.vchBlockSig);
+    uint256 entry;
+    blockSignatureCache.ComputeEntry(entry, block.GetHash(), block.vchBlockSig, pubkey);
+    if (blockSignatureCache.Get(entry, !fCacheStore))
+        return true;
+    if (!pubkey.Verify(block.GetHash(), block.vchBlockSig))
+        return false;
+    if (fCacheStore)
+        blockSignatureCache.Set(entry);
+    return true;
 }
 
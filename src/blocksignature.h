@@ -10,7 +10,14 @@
 #include <primitives/block.h>
 #include <script/signingprovider.h>
 
+//! Memory used by the cache of valid block signatures (8192 entries)
+static const size_t BLOCK_SIGNATURE_CACHE_BYTES = 256 * 1024;
+
 bool SignBlock(CBlock& block, const SigningProvider& keystore);
-bool CheckBlockSignature(const CBlock& block);
+/**
+ * Check the signature of a block. Valid signatures are remembered when
+ * fCacheStore is set; a check without it consumes the cache entry.
+ */
+bool CheckBlockSignature(const CBlock& block, bool fCacheStore = true);
 
 #endif // BLOCKSIGNATURE_H
@@ -0,0 +1,286 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/argon2m.h>
+
+#include <crypto/argon2m/argon2/argon2.h>
+#include <crypto/argon2m/blake2/blake2.h>
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include <compat/cpuid.h>
+
+namespace argon2m_sse41
+{
+void FillBlock(const uint64_t* prev, const uint64_t* ref, uint64_t* next);
+}
+
+namespace argon2m_avx2
+{
+void FillBlock(const uint64_t* prev, const uint64_t* ref, uint64_t* next);
+}
+
+// Internal implementation code.
+namespace
+{
+/// Internal argon2m implementation.
+namespace argon2m
+{
+/** Parameters of the HodlCash proof-of-work instance of Argon2. */
+const uint32_t LANES = 1;
+const uint32_t M_COST = 2;
+const uint32_t T_COST = 1;
+const uint32_t TYPE = Argon2_id;
+const uint32_t VERSION = ARGON2_VERSION_13;
+
+/** Argon2 raises m_cost to 2 blocks per slice and lane: 8 blocks of 1 KiB. */
+const uint32_t SYNC_POINTS = 4;
+const uint32_t MEMORY_BLOCKS = 2 * SYNC_POINTS * LANES;
+const uint32_t SEGMENT_LENGTH = MEMORY_BLOCKS / (LANES * SYNC_POINTS);
+const size_t BLOCK_SIZE = 1024;
+const size_t BLOCK_QWORDS = BLOCK_SIZE / 8;
+const size_t PREHASH_DIGEST_LENGTH = 64;
+const size_t PREHASH_SEED_LENGTH = 72;
+
+uint64_t inline BlaMka(uint64_t x, uint64_t y)
+{
+    const uint64_t m = UINT64_C(0xFFFFFFFF);
+    return x + y + 2 * ((x & m) * (y & m));
+}
+
+uint64_t inline Rotr(uint64_t x, int c) { return (x >> c) | (x << (64 - c)); }
+
+void inline G(uint64_t& a, uint64_t& b, uint64_t& c, uint64_t& d)
+{
+    a = BlaMka(a, b);
+    d = Rotr(d ^ a, 32);
+    c = BlaMka(c, d);
+    b = Rotr(b ^ c, 24);
+    a = BlaMka(a, b);
+    d = Rotr(d ^ a, 16);
+    c = BlaMka(c, d);
+    b = Rotr(b ^ c, 63);
+}
+
+/** BLAKE2b round without message words, applied to 16 qwords picked by idx. */
+void inline Round(uint64_t* v, const unsigned int* idx)
+{
+    G(v[idx[0]], v[idx[4]], v[idx[8]], v[idx[12]]);
+    G(v[idx[1]], v[idx[5]], v[idx[9]], v[idx[13]]);
+    G(v[idx[2]], v[idx[6]], v[idx[10]], v[idx[14]]);
+    G(v[idx[3]], v[idx[7]], v[idx[11]], v[idx[15]]);
+    G(v[idx[0]], v[idx[5]], v[idx[10]], v[idx[15]]);
+    G(v[idx[1]], v[idx[6]], v[idx[11]], v[idx[12]]);
+    G(v[idx[2]], v[idx[7]], v[idx[8]], v[idx[13]]);
+    G(v[idx[3]], v[idx[4]], v[idx[9]], v[idx[14]]);
+}
+
+/** Portable block compression: next = P(prev ^ ref) ^ prev ^ ref. */
+void FillBlock(const uint64_t* prev, const uint64_t* ref, uint64_t* next)
+{
+    uint64_t r[BLOCK_QWORDS];
+    uint64_t x[BLOCK_QWORDS];
+    for (size_t i = 0; i < BLOCK_QWORDS; ++i) {
+        r[i] = x[i] = prev[i] ^ ref[i];
+    }
+
+    unsigned int idx[16];
+    // Rows of 16 consecutive qwords.
+    for (unsigned int i = 0; i < 8; ++i) {
+        for (unsigned int j = 0; j < 16; ++j) {
+            idx[j] = 16 * i + j;
+        }
+        Round(r, idx);
+    }
+    // Columns of qword pairs (2i, 2i+1, 2i+16, 2i+17, ..., 2i+113).
+    for (unsigned int i = 0; i < 8; ++i) {
+        for (unsigned int j = 0; j < 8; ++j) {
+            idx[2 * j] = 2 * i + 16 * j;
+            idx[2 * j + 1] = 2 * i + 16 * j + 1;
+        }
+        Round(r, idx);
+    }
+
+    for (size_t i = 0; i < BLOCK_QWORDS; ++i) {
+        next[i] = r[i] ^ x[i];
+    }
+}
+
+typedef void (*FillBlockType)(const uint64_t*, const uint64_t*, uint64_t*);
+
+void LoadBlock(uint64_t* dst, const unsigned char* src)
+{
+    for (size_t i = 0; i < BLOCK_QWORDS; ++i) {
+        dst[i] = ReadLE64(src + 8 * i);
+    }
+}
+
+void StoreBlock(unsigned char* dst, const uint64_t* src)
+{
+    for (size_t i = 0; i < BLOCK_QWORDS; ++i) {
+        WriteLE64(dst + 8 * i, src[i]);
+    }
+}
+
+void Hash(FillBlockType fill, const unsigned char* in, unsigned char* out)
+{
+    alignas(64) uint64_t memory[MEMORY_BLOCKS][BLOCK_QWORDS];
+    unsigned char bytes[BLOCK_SIZE];
+    unsigned char blockhash[PREHASH_SEED_LENGTH];
+
+    // H0 over the parameters and the header, used as password and salt.
+    unsigned char params[4];
+    blake2b_state state;
+    blake2b_init(&state, PREHASH_DIGEST_LENGTH);
+    const uint32_t prefix[] = {LANES, (uint32_t)ARGON2M_OUTPUT_SIZE, M_COST, T_COST, VERSION, TYPE};
+    for (uint32_t value : prefix) {
+        WriteLE32(params, value);
+        blake2b_update(&state, params, sizeof(params));
+    }
+    WriteLE32(params, ARGON2M_INPUT_SIZE);
+    blake2b_update(&state, params, sizeof(params));
+    blake2b_update(&state, in, ARGON2M_INPUT_SIZE);
+    blake2b_update(&state, params, sizeof(params));
+    blake2b_update(&state, in, ARGON2M_INPUT_SIZE);
+    WriteLE32(params, 0); // no secret, no associated data
+    blake2b_update(&state, params, sizeof(params));
+    blake2b_update(&state, params, sizeof(params));
+    blake2b_final(&state, blockhash, PREHASH_DIGEST_LENGTH);
+
+    // The first two blocks of the lane are G(H0 || i || 0).
+    WriteLE32(blockhash + PREHASH_DIGEST_LENGTH + 4, 0);
+    for (uint32_t i = 0; i < 2; ++i) {
+        WriteLE32(blockhash + PREHASH_DIGEST_LENGTH, i);
+        blake2b_long(bytes, BLOCK_SIZE, blockhash, PREHASH_SEED_LENGTH);
+        LoadBlock(memory[i], bytes);
+    }
+
+    // Single pass, single lane: the reference block is picked from the
+    // previous block's first word among all blocks already filled, except
+    // the immediately preceding one.
+    for (uint32_t i = 2; i < MEMORY_BLOCKS; ++i) {
+        const uint32_t slice = i / SEGMENT_LENGTH;
+        const uint32_t index = i % SEGMENT_LENGTH;
+        const uint32_t reference_area_size = slice * SEGMENT_LENGTH + index - 1;
+        uint64_t relative_position = memory[i - 1][0] & 0xFFFFFFFF;
+        relative_position = relative_position * relative_position >> 32;
+        relative_position = reference_area_size - 1 - (reference_area_size * relative_position >> 32);
+        fill(memory[i - 1], memory[relative_position % MEMORY_BLOCKS], memory[i]);
+    }
+
+    StoreBlock(bytes, memory[MEMORY_BLOCKS - 1]);
+    blake2b_long(out, ARGON2M_OUTPUT_SIZE, bytes, BLOCK_SIZE);
+}
+
+} // namespace argon2m
+
+argon2m::FillBlockType FillBlock = argon2m::FillBlock;
+
+bool SelfTest() {
+    // Compare the selected kernel with the generic argon2_ctx() code on a few
+    // headers, including one whose bytes are all set.
+    unsigned char in[ARGON2M_INPUT_SIZE];
+    unsigned char out[ARGON2M_OUTPUT_SIZE];
+    unsigned char expected[ARGON2M_OUTPUT_SIZE];
+    for (int i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < sizeof(in); ++j) {
+            in[j] = i == 2 ? 0xff : (unsigned char)(j * 7 + i);
+        }
+        Argon2mReferenceHash(in, expected);
+        argon2m::Hash(FillBlock, in, out);
+        if (memcmp(out, expected, sizeof(out))) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+void Argon2mHash(const unsigned char* in, unsigned char* out)
+{
+    argon2m::Hash(FillBlock, in, out);
+}
+
+void Argon2mReferenceHash(const unsigned char* in, unsigned char* out)
+{
+    argon2_context context;
+    context.out = out;
+    context.outlen = ARGON2M_OUTPUT_SIZE;
+    context.pwd = (uint8_t*)in;
+    context.pwdlen = ARGON2M_INPUT_SIZE;
+    context.salt = (uint8_t*)in;
+    context.saltlen = ARGON2M_INPUT_SIZE;
+    context.secret = nullptr;
+    context.secretlen = 0;
+    context.ad = nullptr;
+    context.adlen = 0;
+    context.allocate_cbk = nullptr;
+    context.free_cbk = nullptr;
+    context.flags = ARGON2_FLAG_CLEAR_SECRET;
+    context.m_cost = argon2m::M_COST;
+    context.lanes = argon2m::LANES;
+    context.threads = 1;
+    context.t_cost = argon2m::T_COST;
+    context.version = argon2m::VERSION;
+    argon2_ctx(&context, Argon2_id);
+}
+
+std::string Argon2mAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && defined(HAVE_GETCPUID)
+    bool have_sse4 = false;
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_sse4;
+    (void)have_avx;
+    (void)have_xsave;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    have_sse4 = (ecx >> 19) & 1;
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    if (have_sse4) {
+        GetCPUID(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_sse4) {
+        FillBlock = argon2m_sse41::FillBlock;
+        ret = "sse41";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        FillBlock = argon2m_avx2::FillBlock;
+        ret = "avx2";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
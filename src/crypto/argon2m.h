@@ -0,0 +1,34 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_ARGON2M_H
+#define BITCOIN_CRYPTO_ARGON2M_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Size of the input to the argon2m proof-of-work hash (a block header). */
+static const size_t ARGON2M_INPUT_SIZE = 80;
+/** Size of the argon2m proof-of-work hash. */
+static const size_t ARGON2M_OUTPUT_SIZE = 32;
+
+/** Compute the argon2m proof-of-work hash of an 80-byte block header.
+ *
+ * argon2m is Argon2id v1.3 with data-dependent addressing in every segment,
+ * the header used as both password and salt, t_cost=1, m_cost=2 and a single
+ * lane. This implementation is specialized for exactly those parameters: its
+ * eight 1 KiB working blocks live on the caller's stack, so no memory is
+ * allocated, and the block compression uses the kernel chosen by
+ * Argon2mAutoDetect().
+ */
+void Argon2mHash(const unsigned char* in, unsigned char* out);
+
+/** Compute the same hash through the generic argon2_ctx() code. */
+void Argon2mReferenceHash(const unsigned char* in, unsigned char* out);
+
+/** Autodetect the best available argon2m block kernel. Returns the name of the implementation. */
+std::string Argon2mAutoDetect();
+
+#endif // BITCOIN_CRYPTO_ARGON2M_H
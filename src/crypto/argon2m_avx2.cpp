@@ -0,0 +1,104 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace argon2m_avx2 {
+namespace {
+
+/** One 1 KiB Argon2 block as 32 lanes of four qwords. */
+const int HWORDS_IN_BLOCK = 32;
+
+__m256i inline BlaMka(__m256i x, __m256i y)
+{
+    const __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+__m256i inline Rotr32(__m256i x) { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m256i inline Rotr24(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10)); }
+__m256i inline Rotr16(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9)); }
+__m256i inline Rotr63(__m256i x) { return _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x)); }
+
+/** The BlaMka G function on the four columns of a 4x4 qword matrix. */
+void inline G(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = BlaMka(a, b);
+    d = Rotr32(_mm256_xor_si256(d, a));
+    c = BlaMka(c, d);
+    b = Rotr24(_mm256_xor_si256(b, c));
+    a = BlaMka(a, b);
+    d = Rotr16(_mm256_xor_si256(d, a));
+    c = BlaMka(c, d);
+    b = Rotr63(_mm256_xor_si256(b, c));
+}
+
+/** Full BLAKE2b round without message words on a 4x4 qword matrix. */
+void inline Round(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    G(a, b, c, d);
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+    G(a, b, c, d);
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+/** Gather two qword pairs of a block into one register. */
+__m256i inline Load2(const __m128i* lo, const __m128i* hi)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128(lo)), _mm_load_si128(hi), 1);
+}
+
+void inline Store2(__m128i* lo, __m128i* hi, __m256i x)
+{
+    _mm_store_si128(lo, _mm256_castsi256_si128(x));
+    _mm_store_si128(hi, _mm256_extracti128_si256(x, 1));
+}
+
+} // namespace
+
+void FillBlock(const uint64_t* prev, const uint64_t* ref, uint64_t* next)
+{
+    alignas(32) __m256i state[HWORDS_IN_BLOCK];
+    __m256i x[HWORDS_IN_BLOCK];
+
+    for (int i = 0; i < HWORDS_IN_BLOCK; ++i) {
+        x[i] = state[i] = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)prev + i), _mm256_loadu_si256((const __m256i*)ref + i));
+    }
+
+    // Rows: qwords 16i..16i+15 are four consecutive registers.
+    for (int i = 0; i < 8; ++i) {
+        Round(state[4 * i + 0], state[4 * i + 1], state[4 * i + 2], state[4 * i + 3]);
+    }
+
+    // Columns: qword pairs (2i, 2i+1) of the eight rows.
+    __m128i* pairs = (__m128i*)state;
+    for (int i = 0; i < 8; ++i) {
+        __m256i a = Load2(&pairs[i], &pairs[8 + i]);
+        __m256i b = Load2(&pairs[16 + i], &pairs[24 + i]);
+        __m256i c = Load2(&pairs[32 + i], &pairs[40 + i]);
+        __m256i d = Load2(&pairs[48 + i], &pairs[56 + i]);
+        Round(a, b, c, d);
+        Store2(&pairs[i], &pairs[8 + i], a);
+        Store2(&pairs[16 + i], &pairs[24 + i], b);
+        Store2(&pairs[32 + i], &pairs[40 + i], c);
+        Store2(&pairs[48 + i], &pairs[56 + i], d);
+    }
+
+    for (int i = 0; i < HWORDS_IN_BLOCK; ++i) {
+        _mm256_storeu_si256((__m256i*)next + i, _mm256_xor_si256(state[i], x[i]));
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace argon2m_sse41 {
+namespace {
+
+/** One 1 KiB Argon2 block as 64 lanes of two qwords. */
+const int OWORDS_IN_BLOCK = 64;
+
+__m128i inline BlaMka(__m128i x, __m128i y)
+{
+    const __m128i z = _mm_mul_epu32(x, y);
+    return _mm_add_epi64(_mm_add_epi64(x, y), _mm_add_epi64(z, z));
+}
+
+__m128i inline Rotr32(__m128i x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m128i inline Rotr24(__m128i x) { return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10)); }
+__m128i inline Rotr16(__m128i x) { return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9)); }
+__m128i inline Rotr63(__m128i x) { return _mm_xor_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x)); }
+
+/** The BlaMka G function on four columns held in two register pairs. */
+void inline G(__m128i& a0, __m128i& b0, __m128i& c0, __m128i& d0, __m128i& a1, __m128i& b1, __m128i& c1, __m128i& d1)
+{
+    a0 = BlaMka(a0, b0);
+    a1 = BlaMka(a1, b1);
+    d0 = Rotr32(_mm_xor_si128(d0, a0));
+    d1 = Rotr32(_mm_xor_si128(d1, a1));
+    c0 = BlaMka(c0, d0);
+    c1 = BlaMka(c1, d1);
+    b0 = Rotr24(_mm_xor_si128(b0, c0));
+    b1 = Rotr24(_mm_xor_si128(b1, c1));
+
+    a0 = BlaMka(a0, b0);
+    a1 = BlaMka(a1, b1);
+    d0 = Rotr16(_mm_xor_si128(d0, a0));
+    d1 = Rotr16(_mm_xor_si128(d1, a1));
+    c0 = BlaMka(c0, d0);
+    c1 = BlaMka(c1, d1);
+    b0 = Rotr63(_mm_xor_si128(b0, c0));
+    b1 = Rotr63(_mm_xor_si128(b1, c1));
+}
+
+void inline Diagonalize(__m128i& b0, __m128i& c0, __m128i& d0, __m128i& b1, __m128i& c1, __m128i& d1)
+{
+    __m128i t0 = _mm_alignr_epi8(b1, b0, 8);
+    __m128i t1 = _mm_alignr_epi8(b0, b1, 8);
+    b0 = t0;
+    b1 = t1;
+
+    t0 = c0;
+    c0 = c1;
+    c1 = t0;
+
+    t0 = _mm_alignr_epi8(d1, d0, 8);
+    t1 = _mm_alignr_epi8(d0, d1, 8);
+    d0 = t1;
+    d1 = t0;
+}
+
+void inline Undiagonalize(__m128i& b0, __m128i& c0, __m128i& d0, __m128i& b1, __m128i& c1, __m128i& d1)
+{
+    __m128i t0 = _mm_alignr_epi8(b0, b1, 8);
+    __m128i t1 = _mm_alignr_epi8(b1, b0, 8);
+    b0 = t0;
+    b1 = t1;
+
+    t0 = c0;
+    c0 = c1;
+    c1 = t0;
+
+    t0 = _mm_alignr_epi8(d0, d1, 8);
+    t1 = _mm_alignr_epi8(d1, d0, 8);
+    d0 = t1;
+    d1 = t0;
+}
+
+void inline Round(__m128i& a0, __m128i& a1, __m128i& b0, __m128i& b1, __m128i& c0, __m128i& c1, __m128i& d0, __m128i& d1)
+{
+    G(a0, b0, c0, d0, a1, b1, c1, d1);
+    Diagonalize(b0, c0, d0, b1, c1, d1);
+    G(a0, b0, c0, d0, a1, b1, c1, d1);
+    Undiagonalize(b0, c0, d0, b1, c1, d1);
+}
+
+} // namespace
+
+void FillBlock(const uint64_t* prev, const uint64_t* ref, uint64_t* next)
+{
+    __m128i state[OWORDS_IN_BLOCK];
+    __m128i x[OWORDS_IN_BLOCK];
+
+    for (int i = 0; i < OWORDS_IN_BLOCK; ++i) {
+        x[i] = state[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)prev + i), _mm_loadu_si128((const __m128i*)ref + i));
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        Round(state[8 * i + 0], state[8 * i + 1], state[8 * i + 2], state[8 * i + 3],
+              state[8 * i + 4], state[8 * i + 5], state[8 * i + 6], state[8 * i + 7]);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        Round(state[8 * 0 + i], state[8 * 1 + i], state[8 * 2 + i], state[8 * 3 + i],
+              state[8 * 4 + i], state[8 * 5 + i], state[8 * 6 + i], state[8 * 7 + i]);
+    }
+
+    for (int i = 0; i < OWORDS_IN_BLOCK; ++i) {
+        _mm_storeu_si128((__m128i*)next + i, _mm_xor_si128(state[i], x[i]));
+    }
+}
+
+}
+
+#endif
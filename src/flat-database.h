@@ -9,7 +9,10 @@
 #include <clientversion.h>
 #include <fs.h>
 #include <hash.h>
+#include <logging.h>
 #include <streams.h>
+#include <util/system.h>
+#include <util/time.h>
 
 /** 
 *   Generic Dumping and Loading
@@ -44,7 +47,7 @@ private:
         // serialize, checksum data up to that point, then append checksum
         CDataStream ssObj(SER_DISK, CLIENT_VERSION);
         ssObj << strMagicMessage; // specific magic message for this type of object
-        ssObj << Params().MessageStart(); // network specific magic number
+        ssObj << MakeSpan(Params().MessageStart()); // network specific magic number
         ssObj << objToSave;
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
@@ -131,7 +134,7 @@ private:
 
 
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> pchMsgTmp;
+            ssObj >> MakeSpan(pchMsgTmp);
 
             // ... verify the network matches ours
             if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
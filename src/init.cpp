@@ -19,6 +19,7 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/argon2m.h>
 #include <exceptions.h>
 #include <flat-database.h>
 #include <fs.h>
@@ -60,6 +61,7 @@
 #include <util/validation.h>
 #include <validation.h>
 #include <hash.h>
+#include <wallet/stake.h>
 #include <wallet/wallet.h>
 
 #include <masternode/activemasternode.h>
@@ -223,6 +225,7 @@ void Shutdown(NodeContext& node)
     //   EraseOrphansFor, which locks g_cs_orphans.
     //
     // Thus the implicit locking order requirement is: (1) cs_main, (2) g_cs_orphans, (3) cs_vNodes.
+    if (node.connman) GenerateBitcoins(false, 0, Params(), *node.connman);
     if (node.connman) node.connman->Stop();
 
     StopTorControl();
@@ -243,8 +246,10 @@ void Shutdown(NodeContext& node)
         DumpMempool(::mempool);
     }
 
-    DumpMasternodes();
-    DumpMasternodePayments();
+    FlushMasternodes();
+    pmasternodestore.reset();
+    CFlatDB<CSporkManager> flatdbSporks("sporks.dat", "magicSporkCache");
+    flatdbSporks.Dump(sporkManager);
 
     if (fFeeEstimatesInitialized)
     {
@@ -594,6 +599,8 @@ void SetupServerArgs()
     gArgs.AddArg("-masternodeprivkey", "Masternode private key", ArgsManager::ALLOW_ANY, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-masternodeaddr", "Masternode address and port", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-staking", "Enable staking while working with wallet, default is 1", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-gen", strprintf("Generate proof-of-work blocks (default: %u)", DEFAULT_GENERATE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-genproclimit=<n>", strprintf("Set the number of threads for -gen, -1 for all cores (default: %d)", DEFAULT_GENERATE_THREADS), false, OptionsCategory::OPTIONS);
     hidden_args.emplace_back("-sporkkey");
     gArgs.AddHiddenArgs(hidden_args);
 }
@@ -1181,6 +1188,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string argon2m_algo = Argon2mAutoDetect();
+    LogPrintf("Using the '%s' argon2m implementation\n", argon2m_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1267,6 +1276,11 @@ bool AppInitMain(NodeContext& node)
             return InitError("Unable to sign spork message, wrong key?");
     }
 
+    // the last accepted sporks apply from the start, not only once they are synced again
+    CFlatDB<CSporkManager> flatdbSporks("sporks.dat", "magicSporkCache");
+    if (!flatdbSporks.Load(sporkManager))
+        return InitError(_("Failed to load sporks cache from sporks.dat").translated);
+
     int script_threads = gArgs.GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (script_threads <= 0) {
         // -par=0 means autodetect (number of cores - 1 script threads)
@@ -1280,11 +1294,13 @@ bool AppInitMain(NodeContext& node)
     // Number of script-checking threads <= MAX_SCRIPTCHECK_THREADS
     script_threads = std::min(script_threads, MAX_SCRIPTCHECK_THREADS);
 
-    LogPrintf("Script verification uses %d additional threads\n", script_threads);
+    LogPrintf("Script verification, header hashing and block proof checks use %d additional threads each\n", script_threads);
     if (script_threads >= 1) {
         g_parallel_script_checks = true;
         for (int i = 0; i < script_threads; ++i) {
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadHeaderHashCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadBlockProofCheck(i); });
         }
     }
 
@@ -1772,34 +1788,12 @@ bool AppInitMain(NodeContext& node)
     std::string strDBName;
 
     uiInterface.InitMessage("Loading masternode cache...");
-    CMasternodeDB mndb;
-    CMasternodeDB::ReadResult readResult = mndb.Read(mnodeman);
-    if (readResult == CMasternodeDB::FileError)
-        LogPrintf("Missing masternode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CMasternodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
-        if (readResult == CMasternodeDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-    }
-
-    if(mnodeman.size()) {
-        uiInterface.InitMessage("Loading masternode payment cache...");
-        CMasternodePaymentDB mnpayments;
-        CMasternodePaymentDB::ReadResult readResult = mnpayments.Read(masternodePayments);
-        if (readResult == CMasternodePaymentDB::FileError)
-            LogPrintf("Missing masternode payment cache - mnpayments.dat, will try to recreate\n");
-        else if (readResult != CMasternodePaymentDB::Ok) {
-            LogPrintf("Error reading mnpayments.dat: ");
-            if (readResult == CMasternodePaymentDB::IncorrectFormat)
-                LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-            else
-                LogPrintf("file format is unknown or invalid, please fix it manually\n");
-        }
-    } else {
-        uiInterface.InitMessage("Masternode cache is empty, skipping payments cache...");
-    }
+    if (!LoadMasternodeStore())
+        return InitError(_("Error loading the masternode database").translated);
+
+    // from here on spent collaterals are reported by the blocks that spend them
+    RegisterValidationInterface(&mnodeman);
+    mnodeman.CheckCollaterals();
 
     // ********************************************************* Step 11b: setup Masternode
 
@@ -1934,6 +1928,9 @@ bool AppInitMain(NodeContext& node)
     // ********************************************************* Step 13: finished
 
     node.scheduler->scheduleEvery(boost::bind(&ThreadMasternodePool), std::chrono::seconds{1});
+    node.scheduler->scheduleEvery([] { FlushMasternodes(); }, std::chrono::seconds{MASTERNODES_DUMP_SECONDS});
+    CConnman& connman = *node.connman;
+    threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "mnverify", [&connman] { ThreadMasternodeVerify(connman); }));
 
     SetRPCWarmupFinished();
     uiInterface.InitMessage(_("Done loading").translated);
@@ -1952,11 +1949,19 @@ bool AppInitMain(NodeContext& node)
     GetMainWallet()->m_pay_tx_fee = tx_fee_rate;
     LogPrintf("Set default feerate to %s\n", GetMainWallet()->m_pay_tx_fee.ToString());
 
+    InitSmartstakeCache();
+
     if(!fMasternode && gArgs.GetBoolArg("-staking", true)) {
-        InitSmartstakeCache();
+        for (int i = 0; i < script_threads; ++i) {
+            threadGroup.create_thread([i]() { return ThreadStakeKernelCheck(i); });
+        }
         threadGroup.create_thread(boost::bind(&ThreadStakeMinter, boost::ref(chainparams), boost::ref(*g_rpc_node->connman)));
     }
 
+    if (gArgs.GetBoolArg("-gen", DEFAULT_GENERATE)) {
+        GenerateBitcoins(true, gArgs.GetArg("-genproclimit", DEFAULT_GENERATE_THREADS), chainparams, *g_rpc_node->connman);
+    }
+
     return true;
 }
 
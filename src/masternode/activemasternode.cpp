@@ -47,7 +47,7 @@ void CActiveMasternode::ManageStatus(CConnman& connman)
         CMasternode* pmn;
         pmn = mnodeman.Find(pubKeyMasternode);
         if (pmn) {
-            pmn->Check();
+            mnodeman.CheckMasternode(*pmn);
             if (pmn->IsEnabled() && pmn->protocolVersion == PROTOCOL_VERSION)
                 EnableHotColdMasterNode(pmn->vin, pmn->addr);
         }
@@ -198,6 +198,7 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage, CConnman&
         }
 
         pmn->lastPing = mnp;
+        mnodeman.CheckMasternode(*pmn);
         mnodeman.mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
         //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
@@ -17,10 +17,30 @@
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
 
+#include <script/saltedsigcache.h>
+
 #include <boost/thread/thread.hpp>
 
 CMasternodeSigner masternodeSigner;
 
+namespace {
+/**
+ * Valid masternode message signature cache. The same broadcasts, pings and
+ * sporks reach us from many peers and again on every list resync, so
+ * remember the compact signatures that already recovered to the right key.
+ */
+CSaltedSignatureCache<true> masternodeSignatureCache(MASTERNODE_SIG_CACHE_BYTES);
+} // namespace
+
+CMasternodeSigCacheStats GetMasternodeSigCacheStats()
+{
+    CMasternodeSigCacheStats stats;
+    stats.nHits = masternodeSignatureCache.Hits();
+    stats.nMisses = masternodeSignatureCache.Misses();
+    stats.nCapacity = masternodeSignatureCache.Capacity();
+    return stats;
+}
+
 bool CMasternodeSigner::GetKeysFromSecret(std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     keyRet = DecodeSecret(strSecret);
@@ -78,9 +98,15 @@ bool CMasternodeSigner::VerifyMessage(CPubKey pubkey, std::vector<unsigned char>
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
+    const uint256 hash = ss.GetHash();
+
+    uint256 entry;
+    masternodeSignatureCache.ComputeEntry(entry, hash, vchSig, pubkey);
+    if (masternodeSignatureCache.Get(entry, false))
+        return true;
 
     CPubKey pubkey2;
-    if (!pubkey2.RecoverCompact(ss.GetHash(), vchSig)) {
+    if (!pubkey2.RecoverCompact(hash, vchSig)) {
         errorMessage = "Error recovering public key.";
         return false;
     }
@@ -91,6 +117,9 @@ bool CMasternodeSigner::VerifyMessage(CPubKey pubkey, std::vector<unsigned char>
     else
         LogPrint(BCLog::MASTERNODE, "CMasternodeSigner::VerifyMessage -- keys match: %s %s (called by %s)\n", pubkey2.GetID().ToString(), pubkey.GetID().ToString(), caller);
 
+    if (verifyResult)
+        masternodeSignatureCache.Set(entry);
+
     return verifyResult;
 }
 
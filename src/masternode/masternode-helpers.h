@@ -14,6 +14,16 @@
 
 class COutput;
 
+//! Memory used by the cache of valid masternode message signatures (65536 entries)
+static const size_t MASTERNODE_SIG_CACHE_BYTES = 2 * 1024 * 1024;
+
+/** Usage counters of the masternode message signature cache */
+struct CMasternodeSigCacheStats {
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint32_t nCapacity;
+};
+
 class CMasternodeSigner {
 public:
     bool GetKeysFromSecret(std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet);
@@ -32,6 +42,7 @@ void AvailableCollaterals(std::vector<COutput>& vCoins);
 bool GetMasternodeVinAndKeys(CTxIn& txinRet, CPubKey& pubKeyRet, CKey& keyRet, std::string strTxHash, std::string strOutputIndex);
 bool GetVinFromOutput(COutput out, CTxIn& vinRet, CPubKey& pubkeyRet, CKey& secretKey);
 void ThreadMasternodePool();
+CMasternodeSigCacheStats GetMasternodeSigCacheStats();
 
 extern CMasternodeSigner masternodeSigner;
 
@@ -18,8 +18,6 @@
 /** Object for who's going to get paid on which blocks */
 CMasternodePayments masternodePayments;
 
-RecursiveMutex cs_vecPayments;
-RecursiveMutex cs_mapMasternodeBlocks;
 RecursiveMutex cs_mapMasternodePayeeVotes;
 
 extern int ActiveProtocol();
@@ -242,7 +240,7 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, const s
             nHeight = ::ChainActive().Tip()->nHeight;
         }
 
-        if (masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash())) {
+        if (masternodePayments.HasVote(winner.GetHash())) {
             LogPrint(BCLog::MASTERNODE, "mnw - Already seen - %s bestHeight %d\n", winner.GetHash().ToString().c_str(), nHeight);
             masternodeSync.AddedMasternodeWinner(winner.GetHash());
             return;
@@ -279,8 +277,11 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, const s
 
 bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 {
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetPayee(payee);
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
+
+    const CMasternodeBlockPayees* pblockPayees = FindBlock(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->GetPayee(payee);
     }
 
     return false;
@@ -290,8 +291,6 @@ bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 winners
 bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
 {
-    LOCK(cs_mapMasternodeBlocks);
-
     int nHeight;
     {
         TRY_LOCK(cs_main, locked);
@@ -303,12 +302,15 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
     CScript mnpayee;
     mnpayee = GetScriptForDestination(PKHash(mn.pubKeyCollateralAddress));
 
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
+
     CScript payee;
-    for (int64_t h = nHeight; h <= nHeight + 8; h++) {
+    for (int h = nHeight; h <= nHeight + 8; h++) {
         if (h == nNotBlockHeight)
             continue;
-        if (mapMasternodeBlocks.count(h)) {
-            if (mapMasternodeBlocks[h].GetPayee(payee)) {
+        const CMasternodeBlockPayees* pblockPayees = FindBlock(h);
+        if (pblockPayees) {
+            if (pblockPayees->GetPayee(payee)) {
                 if (mnpayee == payee) {
                     return true;
                 }
@@ -327,32 +329,183 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
     }
 
     {
-        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+        LOCK(cs_mapMasternodePayeeVotes);
+        boost::unique_lock<boost::shared_mutex> lock(mutexBlocks);
 
-        if (mapMasternodePayeeVotes.count(winnerIn.GetHash())) {
+        if (!InsertVote(winnerIn))
             return false;
-        }
+        setDirtyVotes.insert(winnerIn.GetHash());
+    }
+
+    return true;
+}
+
+// Requires mutexBlocks held exclusively
+bool CMasternodePayments::InsertVote(const CMasternodePaymentWinner& winner)
+{
+    AssertLockHeld(cs_mapMasternodePayeeVotes);
+
+    // height 0 marks an empty ring slot and is never paid
+    if (winner.nBlockHeight <= 0)
+        return false;
+
+    if (!mapMasternodePayeeVotes.emplace(winner.GetHash(), winner).second)
+        return false;
+
+    CMasternodeBlockPayees& blockPayees = InsertBlock(winner.nBlockHeight);
+    blockPayees.AddPayee(winner.payee, 1);
+    if (blockPayees.HasPayeeWithVotes(winner.payee, MNPAYMENTS_PAID_VOTES))
+        AddPaidHeight(winner.payee, winner.nBlockHeight);
+    return true;
+}
+
+// Requires mutexBlocks held, shared or exclusively
+const CMasternodeBlockPayees* CMasternodePayments::FindBlock(int nBlockHeight) const
+{
+    const CMasternodeBlockPayees& blockPayees = vBlockRing[nBlockHeight & (vBlockRing.size() - 1)];
+    if (nBlockHeight <= 0 || blockPayees.nBlockHeight != nBlockHeight)
+        return nullptr;
+    return &blockPayees;
+}
 
-        mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+// Requires mutexBlocks held exclusively
+CMasternodeBlockPayees& CMasternodePayments::InsertBlock(int nBlockHeight)
+{
+    while (true) {
+        CMasternodeBlockPayees& blockPayees = vBlockRing[nBlockHeight & (vBlockRing.size() - 1)];
+        if (blockPayees.nBlockHeight == nBlockHeight)
+            return blockPayees;
+        if (blockPayees.nBlockHeight == 0) {
+            blockPayees = CMasternodeBlockPayees(nBlockHeight);
+            nBlockCount++;
+            return blockPayees;
+        }
 
-        if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
-            CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-            mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
+        // the slot still holds a height that is kept: double the ring
+        std::vector<CMasternodeBlockPayees> vOldRing(vBlockRing.size() * 2);
+        vOldRing.swap(vBlockRing);
+        for (CMasternodeBlockPayees& old : vOldRing) {
+            if (old.nBlockHeight != 0)
+                vBlockRing[old.nBlockHeight & (vBlockRing.size() - 1)] = std::move(old);
         }
+        LogPrint(BCLog::MASTERNODE, "CMasternodePayments::InsertBlock - grew the block payee ring to %u heights\n", vBlockRing.size());
     }
+}
+
+// Requires mutexBlocks held exclusively
+void CMasternodePayments::EraseBlock(int nBlockHeight)
+{
+    CMasternodeBlockPayees& blockPayees = vBlockRing[nBlockHeight & (vBlockRing.size() - 1)];
+    if (nBlockHeight <= 0 || blockPayees.nBlockHeight != nBlockHeight)
+        return;
+    ErasePaidHeights(blockPayees);
+    blockPayees = CMasternodeBlockPayees();
+    nBlockCount--;
+}
+
+void CMasternodePayments::Clear()
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    boost::unique_lock<boost::shared_mutex> lock(mutexBlocks);
+
+    for (const auto& entry : mapMasternodePayeeVotes)
+        setDirtyVotes.insert(entry.first);
+    mapMasternodePayeeVotes.clear();
+    vBlockRing.assign(MNPAYMENTS_BLOCK_RING_SIZE, CMasternodeBlockPayees());
+    nBlockCount = 0;
+    mapPayeePaidHeights.clear();
+}
+
+void CMasternodePayments::LoadVote(const CMasternodePaymentWinner& winner)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    boost::unique_lock<boost::shared_mutex> lock(mutexBlocks);
+    InsertVote(winner);
+}
+
+bool CMasternodePayments::HasVote(const uint256& hash)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    return mapMasternodePayeeVotes.count(hash);
+}
 
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+bool CMasternodePayments::GetVote(const uint256& hash, CMasternodePaymentWinner& winner)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
 
+    auto it = mapMasternodePayeeVotes.find(hash);
+    if (it == mapMasternodePayeeVotes.end())
+        return false;
+    winner = it->second;
     return true;
 }
 
-bool CMasternodeBlockPayees::IsTransactionValid(const CTransactionRef& txNew)
+void CMasternodePayments::GetChanges(std::vector<CMasternodePaymentWinner>& vAdded, std::vector<uint256>& vRemoved)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+
+    for (const uint256& hash : setDirtyVotes) {
+        auto it = mapMasternodePayeeVotes.find(hash);
+        if (it != mapMasternodePayeeVotes.end())
+            vAdded.push_back(it->second);
+        else
+            vRemoved.push_back(hash);
+    }
+    setDirtyVotes.clear();
+}
+
+void CMasternodePayments::MarkDirty(const std::vector<CMasternodePaymentWinner>& vAdded, const std::vector<uint256>& vRemoved)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+
+    for (const CMasternodePaymentWinner& winner : vAdded)
+        setDirtyVotes.insert(winner.GetHash());
+    setDirtyVotes.insert(vRemoved.begin(), vRemoved.end());
+}
+
+// Requires mutexBlocks held exclusively
+void CMasternodePayments::AddPaidHeight(const CScript& payee, int nBlockHeight)
+{
+    mapPayeePaidHeights[payee].insert(nBlockHeight);
+}
+
+// Requires mutexBlocks held exclusively
+void CMasternodePayments::ErasePaidHeights(const CMasternodeBlockPayees& blockPayees)
+{
+    for (const CMasternodePayee& payee : blockPayees.vecPayments) {
+        auto it = mapPayeePaidHeights.find(payee.scriptPubKey);
+        if (it == mapPayeePaidHeights.end())
+            continue;
+        it->second.erase(blockPayees.nBlockHeight);
+        if (it->second.empty())
+            mapPayeePaidHeights.erase(it);
+    }
+}
+
+int CMasternodePayments::GetLastPaidHeight(const CScript& payee, int nTipHeight, int nDepth)
 {
-    LOCK(cs_vecPayments);
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
+
+    auto it = mapPayeePaidHeights.find(payee);
+    if (it == mapPayeePaidHeights.end())
+        return -1;
 
+    // Latest paid height not above the tip
+    auto itHeight = it->second.upper_bound(nTipHeight);
+    if (itHeight == it->second.begin())
+        return -1;
+    --itHeight;
+
+    if (*itHeight <= 0 || *itHeight <= nTipHeight - nDepth)
+        return -1;
+    return *itHeight;
+}
+
+bool CMasternodeBlockPayees::IsTransactionValid(const CTransactionRef& txNew) const
+{
     //require at least 6 signatures
     int nMaxSignatures = 0;
-    for (CMasternodePayee& payee : vecPayments)
+    for (const CMasternodePayee& payee : vecPayments)
         if (payee.nVotes >= nMaxSignatures && payee.nVotes >= MNPAYMENTS_SIGNATURES_REQUIRED)
             nMaxSignatures = payee.nVotes;
 
@@ -362,7 +515,7 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransactionRef& txNew)
     std::string strPayeesPossible = "";
     CAmount requiredMasternodePayment = GetMasternodePayment(::ChainActive().Height(), GetBlockSubsidy(::ChainActive().Height(), Params().GetConsensus()));
 
-    for (CMasternodePayee& payee : vecPayments) {
+    for (const CMasternodePayee& payee : vecPayments) {
         bool found = false;
         for (CTxOut out : txNew->vout) {
             if (payee.scriptPubKey == out.scriptPubKey) {
@@ -393,13 +546,11 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransactionRef& txNew)
     return false;
 }
 
-std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
+std::string CMasternodeBlockPayees::GetRequiredPaymentsString() const
 {
-    LOCK(cs_vecPayments);
-
     std::string ret = "Unknown";
 
-    for (CMasternodePayee& payee : vecPayments) {
+    for (const CMasternodePayee& payee : vecPayments) {
         CTxDestination address1;
         ExtractDestination(payee.scriptPubKey, address1);
 
@@ -415,10 +566,11 @@ std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
 
 std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    const CMasternodeBlockPayees* pblockPayees = FindBlock(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -426,10 +578,11 @@ std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 
 bool CMasternodePayments::IsTransactionValid(const CTransactionRef& txNew, int nBlockHeight)
 {
-    LOCK(cs_mapMasternodeBlocks);
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].IsTransactionValid(txNew);
+    const CMasternodeBlockPayees* pblockPayees = FindBlock(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->IsTransactionValid(txNew);
     }
 
     return true;
@@ -437,8 +590,6 @@ bool CMasternodePayments::IsTransactionValid(const CTransactionRef& txNew, int n
 
 void CMasternodePayments::CleanPaymentList()
 {
-    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
-
     int nHeight;
     {
         TRY_LOCK(cs_main, locked);
@@ -448,20 +599,29 @@ void CMasternodePayments::CleanPaymentList()
     }
 
     //keep up to five cycles for historical sake
-    int nLimit = std::max(int(mnodeman.size() * 1.25), 1000);
+    CleanPaymentList(nHeight, std::max(int(mnodeman.size() * 1.25), 1000));
+}
 
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while (it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
+void CMasternodePayments::CleanPaymentList(int nHeight, int nLimit)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
 
-        if (nHeight - winner.nBlockHeight > nLimit) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
-            masternodeSync.mapSeenSyncMNW.erase((*it).first);
-            mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
-        } else {
-            ++it;
-        }
+    // collect the old votes first, so that the block payees are locked only to erase them
+    std::vector<std::pair<uint256, int>> vOldVotes;
+    for (const auto& entry : mapMasternodePayeeVotes) {
+        if (nHeight - entry.second.nBlockHeight > nLimit)
+            vOldVotes.emplace_back(entry.first, entry.second.nBlockHeight);
+    }
+    if (vOldVotes.empty())
+        return;
+
+    boost::unique_lock<boost::shared_mutex> lock(mutexBlocks);
+    for (const auto& vote : vOldVotes) {
+        LogPrint(BCLog::MASTERNODE, "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", vote.second);
+        masternodeSync.mapSeenSyncMNW.erase(vote.first);
+        setDirtyVotes.insert(vote.first);
+        mapMasternodePayeeVotes.erase(vote.first);
+        EraseBlock(vote.second);
     }
 }
 
@@ -550,14 +710,12 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded, CConnman& connman)
         nCountNeeded = nCount;
 
     int nInvCount = 0;
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while (it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
+    for (const auto& entry : mapMasternodePayeeVotes) {
+        const CMasternodePaymentWinner& winner = entry.second;
         if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20) {
-            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, winner.GetHash()));
+            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, entry.first));
             nInvCount++;
         }
-        ++it;
     }
     connman.PushMessage(node, CNetMsgMaker(node->GetSendVersion()).Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_MNW, nInvCount));
 }
@@ -566,23 +724,21 @@ std::string CMasternodePayments::ToString() const
 {
     std::ostringstream info;
 
-    info << "Votes: " << (int)mapMasternodePayeeVotes.size() << ", Blocks: " << (int)mapMasternodeBlocks.size();
+    info << "Votes: " << (int)mapMasternodePayeeVotes.size() << ", Blocks: " << nBlockCount;
 
     return info.str();
 }
 
 int CMasternodePayments::GetOldestBlock()
 {
-    LOCK(cs_mapMasternodeBlocks);
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
 
     int nOldestBlock = std::numeric_limits<int>::max();
 
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while (it != mapMasternodeBlocks.end()) {
-        if ((*it).first < nOldestBlock) {
-            nOldestBlock = (*it).first;
+    for (const CMasternodeBlockPayees& blockPayees : vBlockRing) {
+        if (blockPayees.nBlockHeight != 0 && blockPayees.nBlockHeight < nOldestBlock) {
+            nOldestBlock = blockPayees.nBlockHeight;
         }
-        it++;
     }
 
     return nOldestBlock;
@@ -590,16 +746,14 @@ int CMasternodePayments::GetOldestBlock()
 
 int CMasternodePayments::GetNewestBlock()
 {
-    LOCK(cs_mapMasternodeBlocks);
+    boost::shared_lock<boost::shared_mutex> lock(mutexBlocks);
 
     int nNewestBlock = 0;
 
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while (it != mapMasternodeBlocks.end()) {
-        if ((*it).first > nNewestBlock) {
-            nNewestBlock = (*it).first;
+    for (const CMasternodeBlockPayees& blockPayees : vBlockRing) {
+        if (blockPayees.nBlockHeight > nNewestBlock) {
+            nNewestBlock = blockPayees.nBlockHeight;
         }
-        it++;
     }
 
     return nNewestBlock;
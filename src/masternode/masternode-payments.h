@@ -11,8 +11,10 @@
 #include <masternode/masternode.h>
 #include <validation.h>
 
-extern RecursiveMutex cs_vecPayments;
-extern RecursiveMutex cs_mapMasternodeBlocks;
+#include <unordered_map>
+
+#include <boost/thread/shared_mutex.hpp>
+
 extern RecursiveMutex cs_mapMasternodePayeeVotes;
 
 class CMasternodePayments;
@@ -23,6 +25,10 @@ extern CMasternodePayments masternodePayments;
 
 #define MNPAYMENTS_SIGNATURES_REQUIRED 6
 #define MNPAYMENTS_SIGNATURES_TOTAL 10
+//! Votes a payee needs on a block for that block to count as its last payment
+#define MNPAYMENTS_PAID_VOTES 2
+//! Initial number of heights in the block payee ring, doubled when the kept heights outgrow it
+#define MNPAYMENTS_BLOCK_RING_SIZE 2048
 
 bool IsBlockPayeeValid(const CBlock& block, int nBlockHeight);
 std::string GetRequiredPaymentsString(int nBlockHeight);
@@ -57,6 +63,7 @@ public:
 };
 
 // Keep track of votes for payees from masternodes
+// (guarded by the lock of the CMasternodePayments that holds it)
 class CMasternodeBlockPayees {
 public:
     int nBlockHeight;
@@ -75,8 +82,6 @@ public:
 
     void AddPayee(CScript payeeIn, int nIncrement)
     {
-        LOCK(cs_vecPayments);
-
         for (CMasternodePayee& payee : vecPayments) {
             if (payee.scriptPubKey == payeeIn) {
                 payee.nVotes += nIncrement;
@@ -88,12 +93,10 @@ public:
         vecPayments.push_back(c);
     }
 
-    bool GetPayee(CScript& payee)
+    bool GetPayee(CScript& payee) const
     {
-        LOCK(cs_vecPayments);
-
         int nVotes = -1;
-        for (CMasternodePayee& p : vecPayments) {
+        for (const CMasternodePayee& p : vecPayments) {
             if (p.nVotes > nVotes) {
                 payee = p.scriptPubKey;
                 nVotes = p.nVotes;
@@ -103,11 +106,9 @@ public:
         return (nVotes > -1);
     }
 
-    bool HasPayeeWithVotes(CScript payee, int nVotesReq)
+    bool HasPayeeWithVotes(CScript payee, int nVotesReq) const
     {
-        LOCK(cs_vecPayments);
-
-        for (CMasternodePayee& p : vecPayments) {
+        for (const CMasternodePayee& p : vecPayments) {
             if (p.nVotes >= nVotesReq && p.scriptPubKey == payee)
                 return true;
         }
@@ -115,8 +116,8 @@ public:
         return false;
     }
 
-    bool IsTransactionValid(const CTransactionRef& txNew);
-    std::string GetRequiredPaymentsString();
+    bool IsTransactionValid(const CTransactionRef& txNew) const;
+    std::string GetRequiredPaymentsString() const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -194,30 +195,59 @@ private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
 
-public:
-    std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
-    std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
-    std::map<COutPoint, int> mapMasternodesLastVote; //prevout, nBlockHeight
+    // votes by hash, and the masternodes' last voted heights (cs_mapMasternodePayeeVotes)
+    std::unordered_map<uint256, CMasternodePaymentWinner, SaltedTxidHasher> mapMasternodePayeeVotes;
+    std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapMasternodesLastVote;
+
+    // votes added or removed since the last flush to the masternode store
+    std::set<uint256> setDirtyVotes;
+
+    // Payees of each block, in a ring indexed by height modulo its size, and
+    // the heights where each payee has at least MNPAYMENTS_PAID_VOTES votes.
+    // A slot whose nBlockHeight is not the height looked up is empty. Block
+    // validation only takes mutexBlocks shared, so it never waits behind vote
+    // relay; writers take cs_mapMasternodePayeeVotes first.
+    mutable boost::shared_mutex mutexBlocks;
+    std::vector<CMasternodeBlockPayees> vBlockRing;
+    int nBlockCount;
+    std::map<CScript, std::set<int>> mapPayeePaidHeights;
+
+    const CMasternodeBlockPayees* FindBlock(int nBlockHeight) const;
+    CMasternodeBlockPayees& InsertBlock(int nBlockHeight);
+    void EraseBlock(int nBlockHeight);
+    void AddPaidHeight(const CScript& payee, int nBlockHeight);
+    void ErasePaidHeights(const CMasternodeBlockPayees& blockPayees);
+    bool InsertVote(const CMasternodePaymentWinner& winner);
 
+public:
     CMasternodePayments()
     {
         nSyncedFromPeer = 0;
         nLastBlockHeight = 0;
+        vBlockRing.resize(MNPAYMENTS_BLOCK_RING_SIZE);
+        nBlockCount = 0;
     }
 
-    void Clear()
-    {
-        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
-        mapMasternodeBlocks.clear();
-        mapMasternodePayeeVotes.clear();
-    }
+    void Clear();
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
+    /// Insert a vote read from the masternode store
+    void LoadVote(const CMasternodePaymentWinner& winner);
+    /// Copies of the votes added since the last call, and the hashes of the removed ones
+    void GetChanges(std::vector<CMasternodePaymentWinner>& vAdded, std::vector<uint256>& vRemoved);
+    /// Mark changes taken by GetChanges as unwritten again, after the flush failed
+    void MarkDirty(const std::vector<CMasternodePaymentWinner>& vAdded, const std::vector<uint256>& vRemoved);
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
 
+    bool HasVote(const uint256& hash);
+    bool GetVote(const uint256& hash, CMasternodePaymentWinner& winner);
     void Sync(CNode* node, int nCountNeeded, CConnman& connman);
     void CleanPaymentList();
+    /// Remove the votes for heights more than nLimit blocks below nHeight
+    void CleanPaymentList(int nHeight, int nLimit);
     int LastPayment(CMasternode& mn);
+    /// Most recent height in (nTipHeight - nDepth, nTipHeight] paid to payee, or -1
+    int GetLastPaidHeight(const CScript& payee, int nTipHeight, int nDepth);
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransactionRef& txNew, int nBlockHeight);
@@ -227,14 +257,14 @@ public:
     {
         LOCK(cs_mapMasternodePayeeVotes);
 
-        if (mapMasternodesLastVote.count(outMasternode)) {
-            if (mapMasternodesLastVote[outMasternode] == nBlockHeight) {
+        auto ret = mapMasternodesLastVote.emplace(outMasternode, nBlockHeight);
+        if (!ret.second) {
+            if (ret.first->second == nBlockHeight) {
                 return false;
             }
+            //record this masternode voted
+            ret.first->second = nBlockHeight;
         }
-
-        //record this masternode voted
-        mapMasternodesLastVote[outMasternode] = nBlockHeight;
         return true;
     }
 
@@ -246,13 +276,22 @@ public:
     int GetOldestBlock();
     int GetNewestBlock();
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action)
+    /// Layout of the old mnpayments.dat, only read to import it; the block
+    /// payees are rebuilt from the votes
+    template <typename Stream>
+    void Unserialize(Stream& s)
     {
-        READWRITE(mapMasternodePayeeVotes);
-        READWRITE(mapMasternodeBlocks);
+        std::map<uint256, CMasternodePaymentWinner> mapVotes;
+        std::map<int, CMasternodeBlockPayees> mapBlocks;
+        s >> mapVotes;
+        s >> mapBlocks;
+
+        LOCK(cs_mapMasternodePayeeVotes);
+        boost::unique_lock<boost::shared_mutex> lock(mutexBlocks);
+        for (const auto& entry : mapVotes) {
+            if (InsertVote(entry.second))
+                setDirtyVotes.insert(entry.first);
+        }
     }
 };
 
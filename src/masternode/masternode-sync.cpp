@@ -102,7 +102,7 @@ void CMasternodeSync::AddedMasternodeList(uint256 hash)
 
 void CMasternodeSync::AddedMasternodeWinner(uint256 hash)
 {
-    if (masternodePayments.mapMasternodePayeeVotes.count(hash)) {
+    if (masternodePayments.HasVote(hash)) {
         if (mapSeenSyncMNW[hash] < MASTERNODE_SYNC_THRESHOLD) {
             lastMasternodeWinner = GetTime();
             mapSeenSyncMNW[hash]++;
@@ -172,6 +172,9 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand
                 return;
             sumMasternodeList += nCount;
             countMasternodeList++;
+            // an mnld answer may carry no entries at all
+            if (lastMasternodeList == 0)
+                lastMasternodeList = GetTime();
             break;
         case (MASTERNODE_SYNC_MNW):
             if (nItemID != RequestedMasternodeAssets)
@@ -259,7 +262,12 @@ void CMasternodeSync::Process(CConnman& connman)
                 if (RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD * 3)
                     return;
 
-                mnodeman.DsegUpdate(pnode, connman);
+                // with a list to compare against, ask for the differences only; peers
+                // that do not know mnld never answer, so fall back to dseg for them
+                if (mnodeman.size() && (RequestedMasternodeAttempt < MASTERNODE_SYNC_THRESHOLD || countMasternodeList > 0))
+                    mnodeman.DigestUpdate(pnode, connman);
+                else
+                    mnodeman.DsegUpdate(pnode, connman);
                 RequestedMasternodeAttempt++;
                 return;
             }
@@ -165,13 +165,18 @@ uint256 CMasternode::CalculateScore(int mod, int64_t nBlockHeight)
         return uint256();
 
     uint256 hash = uint256();
-    arith_uint256 aux = UintToArith256(vin.prevout.hash) + vin.prevout.n;
-
     if (!GetBlockHash(hash, nBlockHeight)) {
         LogPrint(BCLog::MASTERNODE, "CalculateScore ERROR - nHeight %d - Returned 0\n", nBlockHeight);
         return uint256();
     }
 
+    return CalculateScore(hash);
+}
+
+uint256 CMasternode::CalculateScore(const uint256& hash) const
+{
+    arith_uint256 aux = UintToArith256(vin.prevout.hash) + vin.prevout.n;
+
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     ss << hash;
     uint256 hash2 = ss.GetHash();
@@ -237,25 +242,13 @@ void CMasternode::Check(bool forceCheck)
         return;
     }
 
-    //test if the collateral is still good
-    if (!unitTest) {
-        CollateralStatus err = CheckCollateral(vin.prevout);
-        if (err == COLLATERAL_UTXO_NOT_FOUND) {
-            nActiveState = MASTERNODE_OUTPOINT_SPENT;
-            LogPrint(BCLog::MASTERNODE, "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToString());
-            return;
-        }
-    }
-
+    // a spent collateral is reported by CMasternodeMan::BlockConnected
     activeState = MASTERNODE_ENABLED; // OK
 }
 
-int64_t CMasternode::SecondsSincePayment()
+int64_t CMasternode::SecondsSincePayment(int nBlockDepth)
 {
-    CScript pubkeyScript;
-    pubkeyScript = GetScriptForDestination(PKHash(pubKeyCollateralAddress));
-
-    int64_t sec = (GetAdjustedTime() - GetLastPaid());
+    int64_t sec = (GetAdjustedTime() - GetLastPaid(nBlockDepth));
     int64_t month = 60 * 60 * 24 * 30;
     if (sec < month)
         return sec;
@@ -269,10 +262,10 @@ int64_t CMasternode::SecondsSincePayment()
     return month + UintToArith256(hash).GetCompact(false);
 }
 
-int64_t CMasternode::GetLastPaid()
+int64_t CMasternode::GetLastPaid(int nBlockDepth)
 {
-    CBlockIndex* pindexPrev = ::ChainActive().Tip();
-    if (pindexPrev == nullptr)
+    const CBlockIndex* pindexTip = ::ChainActive().Tip();
+    if (pindexTip == nullptr)
         return false;
 
     CScript mnpayee;
@@ -286,37 +279,22 @@ int64_t CMasternode::GetLastPaid()
     // use a deterministic offset to break a tie -- 2.5 minutes
     int64_t nOffset = UintToArith256(hash).GetCompact(false) % 150;
 
-    if (::ChainActive().Tip() == nullptr)
-        return false;
+    if (nBlockDepth == -1)
+        nBlockDepth = mnodeman.CountEnabled() * 1.25;
 
-    const CBlockIndex* BlockReading = ::ChainActive().Tip();
+    /*
+        Search for this payee, with at least 2 votes, among the last nBlockDepth blocks. This will aid in
+        consensus allowing the network to converge on the same payees quickly, then keep the same schedule.
+    */
+    int nPaidHeight = masternodePayments.GetLastPaidHeight(mnpayee, pindexTip->nHeight, nBlockDepth);
+    if (nPaidHeight < 0)
+        return 0;
 
-    int nMnCount = mnodeman.CountEnabled() * 1.25;
-    int n = 0;
-    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
-        if (n >= nMnCount) {
-            return 0;
-        }
-        n++;
-
-        if (masternodePayments.mapMasternodeBlocks.count(BlockReading->nHeight)) {
-            /*
-                Search for this payee, with at least 2 votes. This will aid in consensus allowing the network
-                to converge on the same payees quickly, then keep the same schedule.
-            */
-            if (masternodePayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)) {
-                return BlockReading->nTime + nOffset;
-            }
-        }
-
-        if (!BlockReading->pprev) {
-            assert(BlockReading);
-            break;
-        }
-        BlockReading = BlockReading->pprev;
-    }
+    const CBlockIndex* pindexPaid = pindexTip->GetAncestor(nPaidHeight);
+    if (pindexPaid == nullptr)
+        return 0;
 
-    return 0;
+    return pindexPaid->nTime + nOffset;
 }
 
 std::string CMasternode::GetStatus()
@@ -511,32 +489,11 @@ bool CMasternodeBroadcast::CheckAndUpdate(int& nDos, CConnman& connman)
         return false;
     }
 
-    std::string strMessage;
     std::string errorMessage = "";
-
-    // be a bit more tolerant regarding signatures..
-    {
-        std::string vchPubKey(pubKeyCollateralAddress.begin(), pubKeyCollateralAddress.end());
-        std::string vchPubKey2(pubKeyMasternode.begin(), pubKeyMasternode.end());
-        std::string strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
-
-        if (!masternodeSigner.VerifyMessage(pubKeyCollateralAddress, sig, strMessage, errorMessage)) {
-            if (addr.ToString() != addr.ToString(false)) {
-                // maybe it's wrong format, try again with the old one
-                strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
-                if (!masternodeSigner.VerifyMessage(pubKeyCollateralAddress, sig, strMessage, errorMessage)) {
-                    // didn't work either
-                    LogPrintf("mnb - Got bad Masternode address signature, sanitized error: %s\n", SanitizeString(errorMessage));
-                    // there is a bug in old MN signatures, ignore such MN but do not ban the peer we got this from
-                    return false;
-                }
-            } else {
-                // nope, sig is actually wrong
-                LogPrintf("mnb - Got bad Masternode address signature, sanitized error: %s\n", SanitizeString(errorMessage));
-                // there is a bug in old MN signatures, ignore such MN but do not ban the peer we got this from
-                return false;
-            }
-        }
+    if (!CheckAddressSignature(errorMessage)) {
+        LogPrintf("mnb - Got bad Masternode address signature, sanitized error: %s\n", SanitizeString(errorMessage));
+        // there is a bug in old MN signatures, ignore such MN but do not ban the peer we got this from
+        return false;
     }
 
     //search existing Masternode list, this is where we update existing Masternodes with new mnb broadcasts
@@ -563,8 +520,7 @@ bool CMasternodeBroadcast::CheckAndUpdate(int& nDos, CConnman& connman)
     if (pmn->pubKeyCollateralAddress == pubKeyCollateralAddress && !pmn->IsBroadcastedWithin(MASTERNODE_MIN_MNB_SECONDS)) {
         //take the newest entry
         LogPrint(BCLog::MASTERNODE, "mnb - Got updated entry for %s\n", vin.prevout.hash.ToString());
-        if (pmn->UpdateFromNewBroadcast((*this), connman)) {
-            pmn->Check();
+        if (mnodeman.UpdateFromNewBroadcast(*pmn, (*this), connman)) {
             if (pmn->IsEnabled())
                 Relay(connman);
         }
@@ -574,6 +530,25 @@ bool CMasternodeBroadcast::CheckAndUpdate(int& nDos, CConnman& connman)
     return true;
 }
 
+bool CMasternodeBroadcast::CheckAddressSignature(std::string& errorMessage)
+{
+    // be a bit more tolerant regarding signatures..
+    std::string vchPubKey(pubKeyCollateralAddress.begin(), pubKeyCollateralAddress.end());
+    std::string vchPubKey2(pubKeyMasternode.begin(), pubKeyMasternode.end());
+    std::string strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
+
+    if (masternodeSigner.VerifyMessage(pubKeyCollateralAddress, sig, strMessage, errorMessage))
+        return true;
+
+    // nope, sig is actually wrong
+    if (addr.ToString() == addr.ToString(false))
+        return false;
+
+    // maybe it's wrong format, try again with the old one
+    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
+    return masternodeSigner.VerifyMessage(pubKeyCollateralAddress, sig, strMessage, errorMessage);
+}
+
 bool CMasternodeBroadcast::CheckInputsAndAdd(int& nDoS, CConnman& connman)
 {
     // we are a masternode with the same vin (i.e. already activated) and this mnb is ours (matches our Masternode privkey)
@@ -824,7 +799,7 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, CConnman& connman, bool fRequire
                 mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = *this;
             }
 
-            pmn->Check(true);
+            mnodeman.CheckMasternode(*pmn);
             if (!pmn->IsEnabled())
                 return false;
 
@@ -194,6 +194,8 @@ public:
     }
 
     uint256 CalculateScore(int mod = 1, int64_t nBlockHeight = 0);
+    /// Score against the hash of the block the election is based on
+    uint256 CalculateScore(const uint256& hash) const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -220,7 +222,8 @@ public:
         READWRITE(nLastScanningErrorBlockHeight);
     }
 
-    int64_t SecondsSincePayment();
+    /// Seconds since the last payment found within nBlockDepth blocks (-1: the enabled masternode count * 1.25)
+    int64_t SecondsSincePayment(int nBlockDepth = -1);
 
     bool UpdateFromNewBroadcast(CMasternodeBroadcast& mnb, CConnman& connman);
 
@@ -292,7 +295,7 @@ public:
     }
 
     std::string GetStatus();
-    int64_t GetLastPaid();
+    int64_t GetLastPaid(int nBlockDepth = -1);
     bool IsValidNetAddr();
 };
 
@@ -307,6 +310,7 @@ public:
     CMasternodeBroadcast(const CMasternode& mn);
 
     bool CheckAndUpdate(int& nDoS, CConnman& connman);
+    bool CheckAddressSignature(std::string& errorMessage);
     bool CheckInputsAndAdd(int& nDos, CConnman& connman);
     bool Sign(CKey& keyCollateralAddress);
     bool VerifySignature();
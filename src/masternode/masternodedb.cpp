@@ -16,40 +16,160 @@
 
 #include <boost/lexical_cast.hpp>
 
-CMasternodeDB::CMasternodeDB()
+static const char DB_MASTERNODE = 'm';
+static const char DB_PAYMENT_VOTE = 'w';
+static const char DB_VERSION = 'V';
+
+std::unique_ptr<CMasternodeStore> pmasternodestore;
+
+CMasternodeStore::CMasternodeStore(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "masternodes", nCacheSize, fMemory, fWipe)
 {
-    pathMN = GetDataDir() / "mncache.dat";
-    strMagicMessage = "MasternodeCache";
 }
 
-bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
+bool CMasternodeStore::IsCurrentVersion() const
+{
+    int nVersion = 0;
+    return Read(DB_VERSION, nVersion) && nVersion == MASTERNODE_STORE_VERSION;
+}
+
+bool CMasternodeStore::LoadMasternodes(CMasternodeMan& mnodemanToLoad)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_MASTERNODE, COutPoint()));
+
+    while (pcursor->Valid()) {
+        std::pair<char, COutPoint> key;
+        if (!pcursor->GetKey(key) || key.first != DB_MASTERNODE)
+            break;
+        CMasternode mn;
+        if (!pcursor->GetValue(mn))
+            return error("%s : failed to read masternode %s", __func__, key.second.ToString());
+        mnodemanToLoad.LoadMasternode(mn);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CMasternodeStore::LoadPaymentVotes(CMasternodePayments& objToLoad)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_PAYMENT_VOTE, uint256()));
+
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_PAYMENT_VOTE)
+            break;
+        CMasternodePaymentWinner winner;
+        if (!pcursor->GetValue(winner))
+            return error("%s : failed to read payment vote %s", __func__, key.second.ToString());
+        objToLoad.LoadVote(winner);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CMasternodeStore::WriteChanges(const std::vector<CMasternode>& vChanged, const std::vector<COutPoint>& vRemoved,
+                                    const std::vector<CMasternodePaymentWinner>& vVotesAdded, const std::vector<uint256>& vVotesRemoved)
+{
+    CDBBatch batch(*this);
+    for (const CMasternode& mn : vChanged)
+        batch.Write(std::make_pair(DB_MASTERNODE, mn.vin.prevout), mn);
+    for (const COutPoint& outpoint : vRemoved)
+        batch.Erase(std::make_pair(DB_MASTERNODE, outpoint));
+    for (const CMasternodePaymentWinner& winner : vVotesAdded)
+        batch.Write(std::make_pair(DB_PAYMENT_VOTE, winner.GetHash()), winner);
+    for (const uint256& hash : vVotesRemoved)
+        batch.Erase(std::make_pair(DB_PAYMENT_VOTE, hash));
+    return WriteBatch(batch);
+}
+
+bool FlushMasternodes()
 {
+    if (!pmasternodestore)
+        return false;
+
     int64_t nStart = GetTimeMillis();
 
-    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
-    ssMasternodes << strMagicMessage;
-    ssMasternodes << MakeSpan(Params().MessageStart());
-    ssMasternodes << mnodemanToSave;
-    uint256 hash = Hash(ssMasternodes.begin(), ssMasternodes.end());
-    ssMasternodes << hash;
-
-    FILE* file = fsbridge::fopen(pathMN.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
+    std::vector<CMasternode> vChanged;
+    std::vector<COutPoint> vRemoved;
+    std::vector<CMasternodePaymentWinner> vVotesAdded;
+    std::vector<uint256> vVotesRemoved;
+    mnodeman.GetChanges(vChanged, vRemoved);
+    masternodePayments.GetChanges(vVotesAdded, vVotesRemoved);
+
+    if (vChanged.empty() && vRemoved.empty() && vVotesAdded.empty() && vVotesRemoved.empty())
+        return true;
+
     try {
-        fileout << ssMasternodes;
-    } catch (const std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+        if (pmasternodestore->WriteChanges(vChanged, vRemoved, vVotesAdded, vVotesRemoved)) {
+            LogPrint(BCLog::MASTERNODE, "Flushed %d/%d masternodes, %d/%d payment votes (written/removed)  %dms\n",
+                vChanged.size(), vRemoved.size(), vVotesAdded.size(), vVotesRemoved.size(), GetTimeMillis() - nStart);
+            return true;
+        }
+    } catch (const dbwrapper_error& e) {
+        LogPrintf("%s : %s\n", __func__, e.what());
+    }
+
+    // the dirty sets were cleared by GetChanges, keep the changes for the next flush
+    mnodeman.MarkDirty(vChanged, vRemoved);
+    masternodePayments.MarkDirty(vVotesAdded, vVotesRemoved);
+    return error("%s : failed to write masternode changes", __func__);
+}
+
+bool LoadMasternodeStore()
+{
+    int64_t nStart = GetTimeMillis();
+
+    pmasternodestore.reset(new CMasternodeStore(nMasternodeStoreCache << 20));
+    if (pmasternodestore->IsCurrentVersion()) {
+        if (pmasternodestore->LoadMasternodes(mnodeman) && pmasternodestore->LoadPaymentVotes(masternodePayments)) {
+            mnodeman.CheckAndRemove(true);
+            masternodePayments.CleanPaymentList();
+            LogPrint(BCLog::MASTERNODE, "Loaded masternode database  %dms\n", GetTimeMillis() - nStart);
+            LogPrint(BCLog::MASTERNODE, "  %s\n", mnodeman.ToString());
+            LogPrint(BCLog::MASTERNODE, "  %s\n", masternodePayments.ToString());
+            return true;
+        }
+        LogPrintf("Masternode database is corrupted, will try to recreate\n");
+        mnodeman.Clear();
+        masternodePayments.Clear();
+    }
+
+    // no usable database: import mncache.dat and mnpayments.dat once, then drop them
+    pmasternodestore.reset();
+    pmasternodestore.reset(new CMasternodeStore(nMasternodeStoreCache << 20, false, true));
+    if (!pmasternodestore->Write(DB_VERSION, MASTERNODE_STORE_VERSION))
+        return error("%s : failed to initialize the masternode database", __func__);
+
+    CMasternodeDB mndb;
+    CMasternodeDB::ReadResult readResult = mndb.Read(mnodeman);
+    if (readResult == CMasternodeDB::FileError)
+        LogPrintf("Missing masternode cache file - mncache.dat, starting with an empty masternode list\n");
+    else if (readResult != CMasternodeDB::Ok)
+        LogPrintf("Error reading mncache.dat, starting with an empty masternode list\n");
+
+    if (mnodeman.size()) {
+        CMasternodePaymentDB mnpayments;
+        if (mnpayments.Read(masternodePayments) != CMasternodePaymentDB::Ok)
+            LogPrintf("Error reading mnpayments.dat, starting with no payment votes\n");
     }
-    fileout.fclose();
 
-    LogPrint(BCLog::MASTERNODE, "Wrote info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrint(BCLog::MASTERNODE, "  %s\n", mnodemanToSave.ToString());
+    if (!FlushMasternodes())
+        return error("%s : failed to import the masternode cache", __func__);
+
+    fs::remove(GetDataDir() / "mncache.dat");
+    fs::remove(GetDataDir() / "mnpayments.dat");
 
+    LogPrintf("Imported %d masternodes into the masternode database  %dms\n", mnodeman.size(), GetTimeMillis() - nStart);
     return true;
 }
 
+CMasternodeDB::CMasternodeDB()
+{
+    pathMN = GetDataDir() / "mncache.dat";
+    strMagicMessage = "MasternodeCache";
+}
+
 CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
@@ -120,67 +240,12 @@ CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bo
     return Ok;
 }
 
-void DumpMasternodes()
-{
-    int64_t nStart = GetTimeMillis();
-
-    CMasternodeDB mndb;
-    CMasternodeMan tempMnodeman;
-
-    LogPrint(BCLog::MASTERNODE, "Verifying mncache.dat format...\n");
-    CMasternodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
-
-    if (readResult == CMasternodeDB::FileError)
-        LogPrint(BCLog::MASTERNODE, "Missing masternode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CMasternodeDB::Ok) {
-        LogPrint(BCLog::MASTERNODE, "Error reading mncache.dat: ");
-        if (readResult == CMasternodeDB::IncorrectFormat)
-            LogPrint(BCLog::MASTERNODE, "magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint(BCLog::MASTERNODE, "file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrint(BCLog::MASTERNODE, "Writing info to mncache.dat...\n");
-    mndb.Write(mnodeman);
-
-    LogPrint(BCLog::MASTERNODE, "Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
-}
-
 CMasternodePaymentDB::CMasternodePaymentDB()
 {
     pathDB = GetDataDir() / "mnpayments.dat";
     strMagicMessage = "MasternodePayments";
 }
 
-bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;
-    ssObj << MakeSpan(Params().MessageStart());
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    FILE* file = fsbridge::fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    try {
-        fileout << ssObj;
-    } catch (const std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrint(BCLog::MASTERNODE, "Wrote info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
 CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments& objToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
@@ -254,30 +319,3 @@ CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments&
 
     return Ok;
 }
-
-void DumpMasternodePayments()
-{
-    int64_t nStart = GetTimeMillis();
-
-    CMasternodePaymentDB paymentdb;
-    CMasternodePayments tempPayments;
-
-    LogPrint(BCLog::MASTERNODE, "Verifying mnpayments.dat format...\n");
-    CMasternodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
-
-    if (readResult == CMasternodePaymentDB::FileError)
-        LogPrint(BCLog::MASTERNODE, "Missing budgets file - mnpayments.dat, will try to recreate\n");
-    else if (readResult != CMasternodePaymentDB::Ok) {
-        LogPrint(BCLog::MASTERNODE, "Error reading mnpayments.dat: ");
-        if (readResult == CMasternodePaymentDB::IncorrectFormat)
-            LogPrint(BCLog::MASTERNODE, "magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint(BCLog::MASTERNODE, "file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrint(BCLog::MASTERNODE, "Wrote info to mnpayments.dat...\n");
-    paymentdb.Write(masternodePayments);
-
-    LogPrint(BCLog::MASTERNODE, "Budget dump finished  %dms\n", GetTimeMillis() - nStart);
-}
@@ -8,6 +8,7 @@
 #define MASTERNODEDB_H
 
 #include <base58.h>
+#include <dbwrapper.h>
 #include <fs.h>
 #include <key.h>
 #include <masternode/activemasternode.h>
@@ -18,11 +19,36 @@
 #include <util/system.h>
 #include <validation.h>
 
+#include <memory>
+
 class CMasternodeMan;
 
-void DumpMasternodes();
-void DumpMasternodePayments();
+//! Version of the masternodes/ database layout
+static const int MASTERNODE_STORE_VERSION = 1;
+//! Memory allocated to the masternode database cache (MiB)
+static const int64_t nMasternodeStoreCache = 4;
+
+/** Masternode list and payment votes (masternodes/), written incrementally */
+class CMasternodeStore : public CDBWrapper
+{
+public:
+    explicit CMasternodeStore(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool IsCurrentVersion() const;
+    bool LoadMasternodes(CMasternodeMan& mnodemanToLoad);
+    bool LoadPaymentVotes(CMasternodePayments& objToLoad);
+    bool WriteChanges(const std::vector<CMasternode>& vChanged, const std::vector<COutPoint>& vRemoved,
+                      const std::vector<CMasternodePaymentWinner>& vVotesAdded, const std::vector<uint256>& vVotesRemoved);
+};
+
+extern std::unique_ptr<CMasternodeStore> pmasternodestore;
+
+/** Open masternodes/ and load the masternode list and payment votes, importing the old flat files once */
+bool LoadMasternodeStore();
+/** Write the masternode entries and payment votes changed since the last flush */
+bool FlushMasternodes();
 
+/** Reader for the old mncache.dat, only used to import it into the masternode store */
 class CMasternodeDB {
 private:
     fs::path pathMN;
@@ -40,10 +66,10 @@ public:
     };
 
     CMasternodeDB();
-    bool Write(const CMasternodeMan& mnodemanToSave);
     ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
 };
 
+/** Reader for the old mnpayments.dat, only used to import it into the masternode store */
 class CMasternodePaymentDB {
 private:
     fs::path pathDB;
@@ -61,7 +87,6 @@ public:
     };
 
     CMasternodePaymentDB();
-    bool Write(const CMasternodePayments& objToSave);
     ReadResult Read(CMasternodePayments& objToLoad, bool fDryRun = false);
 };
 
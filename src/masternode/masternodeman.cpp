@@ -30,27 +30,269 @@ struct CompareLastPaid {
     }
 };
 
-struct CompareScoreTxIn {
-    bool operator()(const std::pair<int64_t, CTxIn>& t1,
-        const std::pair<int64_t, CTxIn>& t2) const
+struct CompareScoreOutPoint {
+    bool operator()(const std::pair<int64_t, COutPoint>& t1,
+        const std::pair<int64_t, COutPoint>& t2) const
     {
-        return t1.first < t2.first;
+        // highest score first, ties broken by outpoint
+        return t1.first != t2.first ? t1.first > t2.first : t1.second < t2.second;
     }
 };
 
-struct CompareScoreMN {
-    bool operator()(const std::pair<int64_t, CMasternode>& t1,
-        const std::pair<int64_t, CMasternode>& t2) const
-    {
-        return t1.first < t2.first;
-    }
-};
+SaltedKeyIDHasher::SaltedKeyIDHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
 CMasternodeMan::CMasternodeMan()
 {
     nDsqCount = 0;
 }
 
+void CMasternodeMan::AddToIndex(const CMasternode& mn)
+{
+    AssertLockHeld(cs);
+    mapByMasternodeKey.emplace(mn.pubKeyMasternode.GetID(), mn.vin.prevout);
+    mapByCollateralKey.emplace(mn.pubKeyCollateralAddress.GetID(), mn.vin.prevout);
+}
+
+static void EraseIndexEntry(std::unordered_multimap<CKeyID, COutPoint, SaltedKeyIDHasher>& index, const CKeyID& id, const COutPoint& outpoint)
+{
+    auto range = index.equal_range(id);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == outpoint) {
+            index.erase(it);
+            return;
+        }
+    }
+}
+
+void CMasternodeMan::RemoveFromIndex(const CMasternode& mn)
+{
+    AssertLockHeld(cs);
+    EraseIndexEntry(mapByMasternodeKey, mn.pubKeyMasternode.GetID(), mn.vin.prevout);
+    EraseIndexEntry(mapByCollateralKey, mn.pubKeyCollateralAddress.GetID(), mn.vin.prevout);
+}
+
+// The time at which the state of a MN changes if it is not pinged again, 0 if never
+static int64_t GetCheckDeadline(const CMasternode& mn)
+{
+    switch (mn.activeState) {
+    case CMasternode::MASTERNODE_PRE_ENABLED:
+    case CMasternode::MASTERNODE_ENABLED:
+        return mn.lastPing.sigTime + MASTERNODE_EXPIRATION_SECONDS;
+    case CMasternode::MASTERNODE_EXPIRED:
+        return mn.lastPing.sigTime + MASTERNODE_REMOVAL_SECONDS;
+    }
+    return 0;
+}
+
+void CMasternodeMan::UpdateCheckState(const CMasternode& mn)
+{
+    AssertLockHeld(cs);
+
+    EraseCheckState(mn.vin.prevout);
+    setDirtyMasternodes.insert(mn.vin.prevout);
+
+    CheckState state;
+    state.nState = mn.activeState;
+    state.nProtocol = mn.protocolVersion;
+    state.nDeadline = GetCheckDeadline(mn);
+    mapCheckStates.emplace(mn.vin.prevout, state);
+    mapStateCounts[std::make_pair(state.nState, state.nProtocol)]++;
+    if (state.nDeadline)
+        setCheckDeadlines.emplace(state.nDeadline, mn.vin.prevout);
+}
+
+void CMasternodeMan::EraseCheckState(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapCheckStates.find(outpoint);
+    if (it == mapCheckStates.end())
+        return;
+    setDirtyMasternodes.insert(outpoint);
+
+    const CheckState& state = it->second;
+    auto itCount = mapStateCounts.find(std::make_pair(state.nState, state.nProtocol));
+    if (--itCount->second == 0)
+        mapStateCounts.erase(itCount);
+    if (state.nDeadline)
+        setCheckDeadlines.erase(std::make_pair(state.nDeadline, outpoint));
+    mapCheckStates.erase(it);
+}
+
+void CMasternodeMan::CheckDeadlines()
+{
+    AssertLockHeld(cs);
+
+    // collect them first, each entry is checked once even if the clock is adjusted meanwhile
+    std::vector<COutPoint> vDue;
+    const int64_t nNow = GetAdjustedTime();
+    for (auto it = setCheckDeadlines.begin(); it != setCheckDeadlines.end() && it->first <= nNow; ++it)
+        vDue.push_back(it->second);
+
+    for (const COutPoint& outpoint : vDue)
+        CheckMasternode(mapMasternodes.at(outpoint));
+}
+
+void CMasternodeMan::CheckMasternode(CMasternode& mn)
+{
+    LOCK(cs);
+    mn.Check(true);
+    UpdateCheckState(mn);
+}
+
+void CMasternodeMan::SetCollateralSpent(CMasternode& mn, bool fSpent)
+{
+    AssertLockHeld(cs);
+
+    if (fSpent == (mn.activeState == CMasternode::MASTERNODE_VIN_SPENT))
+        return;
+
+    LogPrint(BCLog::MASTERNODE, "CMasternodeMan::SetCollateralSpent -- masternode=%s spent=%d\n", mn.vin.prevout.ToString(), fSpent);
+    if (fSpent) {
+        mn.activeState = CMasternode::MASTERNODE_VIN_SPENT;
+        mn.nActiveState = CMasternode::MASTERNODE_OUTPOINT_SPENT;
+        UpdateCheckState(mn);
+    } else {
+        // Check() leaves spent entries alone
+        mn.activeState = CMasternode::MASTERNODE_ENABLED;
+        mn.nActiveState = CMasternode::MASTERNODE_ENABLED;
+        CheckMasternode(mn);
+    }
+}
+
+void CMasternodeMan::CheckCollaterals()
+{
+    LOCK2(cs_main, cs);
+
+    for (auto& entry : mapMasternodes) {
+        if (CMasternode::CheckCollateral(entry.first) == CMasternode::COLLATERAL_UTXO_NOT_FOUND)
+            SetCollateralSpent(entry.second, true);
+    }
+}
+
+void CMasternodeMan::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+
+    if (mapMasternodes.empty())
+        return;
+
+    for (const CTransactionRef& tx : block->vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            auto it = mapMasternodes.find(txin.prevout);
+            if (it != mapMasternodes.end())
+                SetCollateralSpent(it->second, true);
+        }
+    }
+}
+
+void CMasternodeMan::BlockDisconnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+
+    if (mapMasternodes.empty())
+        return;
+
+    // entries that were not removed yet get their collateral back
+    for (const CTransactionRef& tx : block->vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            auto it = mapMasternodes.find(txin.prevout);
+            if (it != mapMasternodes.end())
+                SetCollateralSpent(it->second, false);
+        }
+    }
+}
+
+void CMasternodeMan::LoadMasternode(const CMasternode& mn)
+{
+    LOCK(cs);
+
+    auto ret = mapMasternodes.emplace(mn.vin.prevout, mn);
+    if (!ret.second)
+        return;
+    AddToIndex(ret.first->second);
+    UpdateCheckState(ret.first->second);
+    setDirtyMasternodes.erase(mn.vin.prevout);
+    mapScoreTables.clear();
+
+    // the seen maps are not stored, the current broadcast and ping of each entry are enough
+    CMasternodeBroadcast mnb(mn);
+    mapSeenMasternodeBroadcast.emplace(mnb.GetHash(), mnb);
+    CMasternodePing mnp = mn.lastPing;
+    if (mnp != CMasternodePing())
+        mapSeenMasternodePing.emplace(mnp.GetHash(), mnp);
+}
+
+void CMasternodeMan::GetChanges(std::vector<CMasternode>& vChanged, std::vector<COutPoint>& vRemoved)
+{
+    LOCK(cs);
+
+    for (const COutPoint& outpoint : setDirtyMasternodes) {
+        auto it = mapMasternodes.find(outpoint);
+        if (it != mapMasternodes.end())
+            vChanged.push_back(it->second);
+        else
+            vRemoved.push_back(outpoint);
+    }
+    setDirtyMasternodes.clear();
+}
+
+void CMasternodeMan::MarkDirty(const std::vector<CMasternode>& vChanged, const std::vector<COutPoint>& vRemoved)
+{
+    LOCK(cs);
+
+    for (const CMasternode& mn : vChanged)
+        setDirtyMasternodes.insert(mn.vin.prevout);
+    setDirtyMasternodes.insert(vRemoved.begin(), vRemoved.end());
+}
+
+void CMasternodeMan::EraseMasternode(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs);
+
+    auto it = mapMasternodes.find(outpoint);
+    if (it == mapMasternodes.end())
+        return;
+    RemoveFromIndex(it->second);
+    EraseCheckState(outpoint);
+    mapMasternodes.erase(it);
+    mapScoreTables.clear();
+}
+
+const CMasternodeMan::MasternodeScores* CMasternodeMan::GetScoreTable(int64_t nBlockHeight)
+{
+    AssertLockHeld(cs);
+
+    //make sure we know about this block
+    uint256 hash;
+    if (!GetBlockHash(hash, nBlockHeight))
+        return nullptr;
+
+    auto it = mapScoreTables.find(nBlockHeight);
+    if (it != mapScoreTables.end() && it->second.first == hash)
+        return &it->second.second;
+
+    MasternodeScores vecScores;
+    vecScores.reserve(mapMasternodes.size());
+    for (const auto& entry : mapMasternodes) {
+        int64_t n2 = UintToArith256(entry.second.CalculateScore(hash)).GetCompact(false);
+        vecScores.emplace_back(n2, entry.first);
+    }
+    sort(vecScores.begin(), vecScores.end(), CompareScoreOutPoint());
+
+    if (it == mapScoreTables.end() && mapScoreTables.size() >= MASTERNODES_SCORE_TABLES)
+        mapScoreTables.erase(mapScoreTables.begin());
+
+    std::pair<uint256, MasternodeScores>& table = mapScoreTables[nBlockHeight];
+    table.first = hash;
+    table.second.swap(vecScores);
+    return &table.second;
+}
+
 bool CMasternodeMan::Add(CMasternode& mn)
 {
     LOCK(cs);
@@ -58,14 +300,15 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (!mn.IsEnabled())
         return false;
 
-    CMasternode* pmn = Find(mn.vin);
-    if (!pmn) {
-        LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
-        vMasternodes.push_back(mn);
-        return true;
-    }
+    if (mapMasternodes.count(mn.vin.prevout))
+        return false;
 
-    return false;
+    LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
+    CMasternode& mnNew = mapMasternodes.emplace(mn.vin.prevout, mn).first->second;
+    AddToIndex(mnNew);
+    CheckMasternode(mnNew);
+    mapScoreTables.clear();
+    return true;
 }
 
 void CMasternodeMan::AskForMN(CNode* pnode, CTxIn& vin, CConnman& connman)
@@ -87,10 +330,7 @@ void CMasternodeMan::AskForMN(CNode* pnode, CTxIn& vin, CConnman& connman)
 void CMasternodeMan::Check()
 {
     LOCK(cs);
-
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
-    }
+    CheckDeadlines();
 }
 
 void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
@@ -100,17 +340,18 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
-    std::vector<CMasternode>::iterator it = vMasternodes.begin();
-    while (it != vMasternodes.end()) {
-        if ((*it).activeState == CMasternode::MASTERNODE_REMOVE || (*it).activeState == CMasternode::MASTERNODE_VIN_SPENT || (forceExpiredRemoval && (*it).activeState == CMasternode::MASTERNODE_EXPIRED) || (*it).protocolVersion < masternodePayments.GetMinMasternodePaymentsProto()) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing inactive Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+    auto it = mapMasternodes.begin();
+    while (it != mapMasternodes.end()) {
+        const CMasternode& mn = it->second;
+        if (mn.activeState == CMasternode::MASTERNODE_REMOVE || mn.activeState == CMasternode::MASTERNODE_VIN_SPENT || (forceExpiredRemoval && mn.activeState == CMasternode::MASTERNODE_EXPIRED) || mn.protocolVersion < masternodePayments.GetMinMasternodePaymentsProto()) {
+            LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing inactive Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() - 1);
 
             //erase all of the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new mnb
             std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
             while (it3 != mapSeenMasternodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
+                if ((*it3).second.vin == mn.vin) {
                     masternodeSync.mapSeenSyncMNB.erase((*it3).first);
                     mapSeenMasternodeBroadcast.erase(it3++);
                 } else {
@@ -121,14 +362,17 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             // allow us to ask for this masternode again if we see another ping
             std::map<COutPoint, int64_t>::iterator it2 = mWeAskedForMasternodeListEntry.begin();
             while (it2 != mWeAskedForMasternodeListEntry.end()) {
-                if ((*it2).first == (*it).vin.prevout) {
+                if ((*it2).first == mn.vin.prevout) {
                     mWeAskedForMasternodeListEntry.erase(it2++);
                 } else {
                     ++it2;
                 }
             }
 
-            it = vMasternodes.erase(it);
+            RemoveFromIndex(mn);
+            EraseCheckState(mn.vin.prevout);
+            it = mapMasternodes.erase(it);
+            mapScoreTables.clear();
         } else {
             ++it;
         }
@@ -190,7 +434,15 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
-    vMasternodes.clear();
+    for (const auto& entry : mapMasternodes)
+        setDirtyMasternodes.insert(entry.first);
+    mapMasternodes.clear();
+    mapByMasternodeKey.clear();
+    mapByCollateralKey.clear();
+    mapCheckStates.clear();
+    mapStateCounts.clear();
+    setCheckDeadlines.clear();
+    mapScoreTables.clear();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -201,12 +453,16 @@ void CMasternodeMan::Clear()
 
 int CMasternodeMan::stable_size()
 {
+    LOCK(cs);
+    CheckDeadlines();
+
     int nStable_size = 0;
     int nMinProtocol = ActiveProtocol();
     int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
     int64_t nMasternode_Age = 0;
 
-    for (CMasternode& mn : vMasternodes) {
+    for (auto& entry : mapMasternodes) {
+        CMasternode& mn = entry.second;
         if (mn.protocolVersion < nMinProtocol) {
             continue; // Skip obsolete versions
         }
@@ -216,7 +472,6 @@ int CMasternodeMan::stable_size()
                 continue; // Skip masternodes younger than (default) 8000 sec (MUST be > MASTERNODE_REMOVAL_SECONDS)
             }
         }
-        mn.Check();
         if (!mn.IsEnabled())
             continue; // Skip not-enabled masternodes
 
@@ -228,25 +483,28 @@ int CMasternodeMan::stable_size()
 
 int CMasternodeMan::CountEnabled(int protocolVersion)
 {
+    LOCK(cs);
+    CheckDeadlines();
+
     int i = 0;
     protocolVersion = protocolVersion == -1 ? masternodePayments.GetMinMasternodePaymentsProto() : protocolVersion;
 
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
-        if (mn.protocolVersion < protocolVersion || !mn.IsEnabled())
-            continue;
-        i++;
-    }
+    // enabled MNs are counted by protocol version
+    auto it = mapStateCounts.lower_bound(std::make_pair((int)CMasternode::MASTERNODE_ENABLED, protocolVersion));
+    for (; it != mapStateCounts.end() && it->first.first == CMasternode::MASTERNODE_ENABLED; ++it)
+        i += it->second;
 
     return i;
 }
 
 void CMasternodeMan::CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion)
 {
+    LOCK(cs);
+
     protocolVersion = protocolVersion == -1 ? masternodePayments.GetMinMasternodePaymentsProto() : protocolVersion;
 
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
+    for (auto& entry : mapMasternodes) {
+        CMasternode& mn = entry.second;
         std::string strHost;
         int port;
         SplitHostPort(mn.addr.ToString(), port, strHost);
@@ -287,13 +545,128 @@ void CMasternodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
+void CMasternodeMan::DigestUpdate(CNode* pnode, CConnman& connman)
+{
+    std::vector<uint256> vDigest;
+    {
+        LOCK(cs);
+
+        if (!(pnode->addr.IsRFC1918() || pnode->addr.IsLocal())) {
+            std::map<CNetAddr, int64_t>::iterator it = mWeAskedForMasternodeList.find(pnode->addr);
+            if (it != mWeAskedForMasternodeList.end()) {
+                if (GetTime() < (*it).second) {
+                    LogPrint(BCLog::MASTERNODE, "mnld - we already asked peer %i for the list; skipping...\n", pnode->GetId());
+                    return;
+                }
+            }
+        }
+
+        GetListDigest(vDigest);
+        mWeAskedForMasternodeList[pnode->addr] = GetTime() + MASTERNODES_DSEG_SECONDS;
+    }
+
+    connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MNLISTDIGEST, vDigest));
+
+    LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DigestUpdate -- asked %s for the list differences\n", pnode->addr.ToString());
+}
+
+// the entries dseg and mnld hand out
+static bool IsListedInSync(CMasternode& mn)
+{
+    return mn.IsEnabled() && !mn.addr.IsRFC1918();
+}
+
+static unsigned int GetDigestBucket(const COutPoint& outpoint)
+{
+    return *outpoint.hash.begin() % MASTERNODES_DIGEST_BUCKETS;
+}
+
+static uint256 GetDigestEntry(const COutPoint& outpoint, const uint256& hashBroadcast)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << outpoint << hashBroadcast;
+    return ss.GetHash();
+}
+
+void CMasternodeMan::GetListDigest(std::vector<uint256>& vDigest)
+{
+    LOCK(cs);
+
+    // XOR of the entry hashes, so that the buckets do not depend on the map order
+    vDigest.assign(MASTERNODES_DIGEST_BUCKETS, uint256());
+    for (auto& entry : mapMasternodes) {
+        CMasternode& mn = entry.second;
+        if (!IsListedInSync(mn))
+            continue;
+        uint256 hash = GetDigestEntry(mn.vin.prevout, CMasternodeBroadcast(mn).GetHash());
+        uint256& bucket = vDigest[GetDigestBucket(mn.vin.prevout)];
+        for (unsigned int i = 0; i < bucket.size(); i++)
+            bucket.begin()[i] ^= hash.begin()[i];
+    }
+}
+
+int CMasternodeMan::PushListEntries(CNode* pfrom, const std::vector<uint256>& vDigestPeer)
+{
+    LOCK(cs);
+
+    std::vector<uint256> vDigest;
+    GetListDigest(vDigest);
+
+    int nInvCount = 0;
+    for (auto& entry : mapMasternodes) {
+        CMasternode& mn = entry.second;
+        if (!IsListedInSync(mn) || vDigest[GetDigestBucket(mn.vin.prevout)] == vDigestPeer[GetDigestBucket(mn.vin.prevout)])
+            continue;
+
+        CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+        uint256 hash = mnb.GetHash();
+        pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+        nInvCount++;
+
+        if (!mapSeenMasternodeBroadcast.count(hash))
+            mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
+    }
+    return nInvCount;
+}
+
+bool CMasternodeMan::CheckListRequest(CNode* pfrom)
+{
+    AssertLockHeld(cs_main);
+
+    //local network
+    bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+
+    if (!isLocal && Params().NetworkIDString() == "main") {
+        std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
+        if (i != mAskedUsForMasternodeList.end()) {
+            int64_t t = (*i).second;
+            if (GetTime() < t) {
+                LogPrint(BCLog::MASTERNODE, "CMasternodeMan::ProcessMessage() : dseg - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 34);
+                return false;
+            }
+        }
+        int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
+        mAskedUsForMasternodeList[pfrom->addr] = askAgain;
+    }
+    return true;
+}
+
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
 
-    for (CMasternode& mn : vMasternodes)
-        if (GetScriptForDestination(PKHash(mn.pubKeyCollateralAddress)) == payee)
-            return &mn;
+    // masternodes are paid to the key hash of their collateral key
+    CTxDestination dest;
+    if (!ExtractDestination(payee, dest) || !boost::get<PKHash>(&dest))
+        return nullptr;
+
+    auto range = mapByCollateralKey.equal_range(CKeyID(*boost::get<PKHash>(&dest)));
+    for (auto it = range.first; it != range.second; ++it) {
+        CMasternode* pmn = &mapMasternodes.at(it->second);
+        if (GetScriptForDestination(PKHash(pmn->pubKeyCollateralAddress)) == payee)
+            return pmn;
+    }
     return nullptr;
 }
 
@@ -301,22 +674,36 @@ CMasternode* CMasternodeMan::Find(const CTxIn& vin)
 {
     LOCK(cs);
 
-    for (CMasternode& mn : vMasternodes)
-        if (mn.vin.prevout == vin.prevout)
-            return &mn;
-    return nullptr;
+    auto it = mapMasternodes.find(vin.prevout);
+    if (it == mapMasternodes.end())
+        return nullptr;
+    return &it->second;
 }
 
 CMasternode* CMasternodeMan::Find(const CPubKey& pubKeyMasternode)
 {
     LOCK(cs);
 
-    for (CMasternode& mn : vMasternodes)
-        if (mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
+    auto range = mapByMasternodeKey.equal_range(pubKeyMasternode.GetID());
+    for (auto it = range.first; it != range.second; ++it) {
+        CMasternode* pmn = &mapMasternodes.at(it->second);
+        if (pmn->pubKeyMasternode == pubKeyMasternode)
+            return pmn;
+    }
     return nullptr;
 }
 
+std::vector<CMasternode> CMasternodeMan::GetMasternodeVector() const
+{
+    LOCK(cs);
+
+    std::vector<CMasternode> vMasternodes;
+    vMasternodes.reserve(mapMasternodes.size());
+    for (const auto& entry : mapMasternodes)
+        vMasternodes.push_back(entry.second);
+    return vMasternodes;
+}
+
 //
 // Deterministically select the oldest/best masternode to pay on the network
 //
@@ -332,8 +719,9 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     */
 
     int nMnCount = CountEnabled();
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
+    int nPaidDepth = nMnCount * 1.25;
+    for (auto& entry : mapMasternodes) {
+        CMasternode& mn = entry.second;
         if (!mn.IsEnabled())
             continue;
 
@@ -353,7 +741,7 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
         if (mn.GetMasternodeInputAge() < nMnCount)
             continue;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mn.SecondsSincePayment(), mn.vin));
+        vecMasternodeLastPaid.push_back(std::make_pair(mn.SecondsSincePayment(nPaidDepth), mn.vin));
     }
 
     nCount = (int)vecMasternodeLastPaid.size();
@@ -369,7 +757,7 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
     //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
     //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = CountEnabled() / 10;
+    int nTenthNetwork = nMnCount / 10;
     int nCountTenth = 0;
     arith_uint256 nHigh;
     for (const auto s : vecMasternodeLastPaid) {
@@ -403,7 +791,8 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclude
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::FindRandomNotInVec - rand %d\n", rand);
     bool found;
 
-    for (CMasternode& mn : vMasternodes) {
+    for (auto& entry : mapMasternodes) {
+        CMasternode& mn = entry.second;
         if (mn.protocolVersion < protocolVersion || !mn.IsEnabled())
             continue;
         found = false;
@@ -425,71 +814,49 @@ CMasternode* CMasternodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclude
 
 CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
-    int64_t score = 0;
-    CMasternode* winner = nullptr;
+    LOCK(cs);
+
+    const MasternodeScores* pvecScores = GetScoreTable(nBlockHeight);
+    if (!pvecScores)
+        return nullptr;
+    CheckDeadlines();
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
+    // the winner is the best scored enabled Masternode
+    for (const auto& s : *pvecScores) {
+        if (s.first <= 0)
+            break;
+        CMasternode& mn = mapMasternodes.at(s.second);
         if (mn.protocolVersion < minProtocol || !mn.IsEnabled())
             continue;
-
-        // calculate the score for each Masternode
-        uint256 n = mn.CalculateScore(mod, nBlockHeight);
-        int64_t n2 = UintToArith256(n).GetCompact(false);
-
-        // determine the winner
-        if (n2 > score) {
-            score = n2;
-            winner = &mn;
-        }
+        return &mn;
     }
 
-    return winner;
+    return nullptr;
 }
 
 int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CTxIn>> vecMasternodeScores;
-    int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
-    int64_t nMasternode_Age = 0;
+    LOCK(cs);
 
-    //make sure we know about this block
-    uint256 hash;
-    if (!GetBlockHash(hash, nBlockHeight))
+    const MasternodeScores* pvecScores = GetScoreTable(nBlockHeight);
+    if (!pvecScores)
         return -1;
+    CheckDeadlines();
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
-        if (mn.protocolVersion < minProtocol) {
-            LogPrint(BCLog::MASTERNODE, "Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
-            continue; // Skip obsolete versions
-        }
-
-        if (sporkManager.IsSporkActive(Spork::SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
-            nMasternode_Age = GetAdjustedTime() - mn.sigTime;
-            if ((nMasternode_Age) < nMasternode_Min_Age) {
-                LogPrint(BCLog::MASTERNODE, "Skipping just activated Masternode. Age: %ld\n", nMasternode_Age);
-                continue; // Skip masternodes younger than (default) 1 hour
-            }
-        }
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled())
-                continue;
-        }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = UintToArith256(n).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+    bool fCheckAge = sporkManager.IsSporkActive(Spork::SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT);
+    int64_t nNow = GetAdjustedTime();
 
     int rank = 0;
-    for (const auto& s : vecMasternodeScores) {
+    for (const auto& s : *pvecScores) {
+        CMasternode& mn = mapMasternodes.at(s.second);
+        if (mn.protocolVersion < minProtocol)
+            continue; // Skip obsolete versions
+        if (fCheckAge && nNow - mn.sigTime < MN_WINNER_MINIMUM_AGE)
+            continue; // Skip masternodes younger than (default) 1 hour
+        if (fOnlyActive && !mn.IsEnabled())
+            continue;
         rank++;
-        if (s.second.prevout == vin.prevout) {
+        if (s.second == vin.prevout) {
             return rank;
         }
     }
@@ -499,38 +866,32 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
 
 std::vector<std::pair<int, CMasternode>> CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
-    std::vector<std::pair<int64_t, CMasternode>> vecMasternodeScores;
+    LOCK(cs);
+
     std::vector<std::pair<int, CMasternode>> vecMasternodeRanks;
 
-    //make sure we know about this block
-    uint256 hash = uint256();
-    if (!GetBlockHash(hash, nBlockHeight))
+    const MasternodeScores* pvecScores = GetScoreTable(nBlockHeight);
+    if (!pvecScores)
         return vecMasternodeRanks;
+    CheckDeadlines();
 
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
-
+    // enabled Masternodes by score, followed by the others
+    std::vector<const CMasternode*> vecNotEnabled;
+    for (const auto& s : *pvecScores) {
+        CMasternode& mn = mapMasternodes.at(s.second);
         if (mn.protocolVersion < minProtocol)
             continue;
 
         if (!mn.IsEnabled()) {
-            vecMasternodeScores.push_back(std::make_pair(9999, mn));
+            vecNotEnabled.push_back(&mn);
             continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = UintToArith256(n).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn));
+        vecMasternodeRanks.push_back(std::make_pair(vecMasternodeRanks.size() + 1, mn));
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    for (const auto& s : vecMasternodeScores) {
-        rank++;
-        vecMasternodeRanks.push_back(std::make_pair(rank, s.second));
+    for (const CMasternode* pmn : vecNotEnabled) {
+        vecMasternodeRanks.push_back(std::make_pair(vecMasternodeRanks.size() + 1, *pmn));
     }
 
     return vecMasternodeRanks;
@@ -538,31 +899,23 @@ std::vector<std::pair<int, CMasternode>> CMasternodeMan::GetMasternodeRanks(int6
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CTxIn>> vecMasternodeScores;
-
-    // scan for winner
-    for (CMasternode& mn : vMasternodes) {
-        if (mn.protocolVersion < minProtocol)
-            continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled())
-                continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = UintToArith256(n).GetCompact(false);
-
-        vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
-    }
+    LOCK(cs);
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+    const MasternodeScores* pvecScores = GetScoreTable(nBlockHeight);
+    if (!pvecScores)
+        return nullptr;
+    CheckDeadlines();
 
     int rank = 0;
-    for (const auto& s : vecMasternodeScores) {
+    for (const auto& s : *pvecScores) {
+        CMasternode& mn = mapMasternodes.at(s.second);
+        if (mn.protocolVersion < minProtocol)
+            continue;
+        if (fOnlyActive && !mn.IsEnabled())
+            continue;
         rank++;
         if (rank == nRank) {
-            return Find(s.second);
+            return &mn;
         }
     }
 
@@ -590,105 +943,75 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
     if (!masternodeSync.IsBlockchainSynced())
         return;
 
+    // dseg and mnld can penalize the peer, so take cs_main first, in the
+    // same order as the mnb and mnp batches
+    if (strCommand == NetMsgType::DSEG || strCommand == NetMsgType::MNLISTDIGEST) {
+        LOCK2(cs_main, cs_process_message);
+        ProcessListRequest(pfrom, strCommand, vRecv, connman);
+        return;
+    }
+
     LOCK(cs_process_message);
 
     if (strCommand == NetMsgType::MNBROADCAST) {
 
-        CMasternodeBroadcast mnb;
-        vRecv >> mnb;
-
-        if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { //seen
-            masternodeSync.AddedMasternodeList(mnb.GetHash());
-            return;
-        }
-        mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
-
-        int nDoS = 0;
-        if (!mnb.CheckAndUpdate(nDoS, connman)) {
-            if (nDoS > 0)
-                Misbehaving(pfrom->GetId(), nDoS);
-
-            //failed
-            return;
-        }
+        CMasternodePendingMessage msg;
+        vRecv >> msg.mnb;
 
-        // make sure the vout that was signed is related to the transaction that spawned the Masternode
-        //  - this is expensive, so it's only done once per Masternode
-        if (!masternodeSigner.IsVinAssociatedWithPubkey(mnb.vin, mnb.pubKeyCollateralAddress)) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan::ProcessMessage() : mnb - Got mismatched pubkey and vin\n");
-            Misbehaving(pfrom->GetId(), 33);
+        uint256 hash = msg.mnb.GetHash();
+        if (mapSeenMasternodeBroadcast.count(hash)) { //seen
+            masternodeSync.AddedMasternodeList(hash);
             return;
         }
-
-        // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
-        if (mnb.CheckInputsAndAdd(nDoS, connman)) {
-            masternodeSync.AddedMasternodeList(mnb.GetHash());
-        } else {
-            LogPrint(BCLog::MASTERNODE, "mnb - Rejected Masternode entry %s\n", mnb.vin.prevout.hash.ToString());
-
-            if (nDoS > 0)
-                Misbehaving(pfrom->GetId(), nDoS);
-        }
+        mapSeenMasternodeBroadcast.insert(std::make_pair(hash, msg.mnb));
+
+        // verified by ThreadMasternodeVerify, forget it if the queue is full
+        // so that it is fetched again
+        msg.nodeId = pfrom->GetId();
+        msg.fPing = false;
+        if (!PushPendingMessage(msg))
+            mapSeenMasternodeBroadcast.erase(hash);
         return;
     }
 
     else if (strCommand == NetMsgType::MNPING) {
-        CMasternodePing mnp;
-        vRecv >> mnp;
+        CMasternodePendingMessage msg;
+        vRecv >> msg.mnp;
 
-        LogPrint(BCLog::MASTERNODE, "mnp - Masternode ping, vin: %s\n", mnp.vin.prevout.hash.ToString());
+        LogPrint(BCLog::MASTERNODE, "mnp - Masternode ping, vin: %s\n", msg.mnp.vin.prevout.hash.ToString());
 
-        if (mapSeenMasternodePing.count(mnp.GetHash()))
+        uint256 hash = msg.mnp.GetHash();
+        if (mapSeenMasternodePing.count(hash))
             return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
-
-        int nDoS = 0;
-        if (mnp.CheckAndUpdate(nDoS, connman))
-            return;
-
-        if (nDoS > 0) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), nDoS);
-        } else {
-            CMasternode* pmn = Find(mnp.vin);
-            if (pmn)
-                return;
-        }
+        mapSeenMasternodePing.insert(std::make_pair(hash, msg.mnp));
 
-        // something significant is broken or mn is unknown,
-        // we might have to ask for a masternode entry once
-        AskForMN(pfrom, mnp.vin, connman);
+        msg.nodeId = pfrom->GetId();
+        msg.fPing = true;
+        if (!PushPendingMessage(msg))
+            mapSeenMasternodePing.erase(hash);
         return;
     }
+}
 
-    else if (strCommand == NetMsgType::DSEG) {
+void CMasternodeMan::ProcessListRequest(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_process_message);
+
+    if (strCommand == NetMsgType::DSEG) {
 
         CTxIn vin;
         vRecv >> vin;
 
         if (vin == CTxIn()) { //only should ask for this once
-            //local network
-            bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
-
-            if (!isLocal && Params().NetworkIDString() == "main") {
-                std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
-                if (i != mAskedUsForMasternodeList.end()) {
-                    int64_t t = (*i).second;
-                    if (GetTime() < t) {
-                        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::ProcessMessage() : dseg - peer already asked me for the list\n");
-                        Misbehaving(pfrom->GetId(), 34);
-                        return;
-                    }
-                }
-                int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
-                mAskedUsForMasternodeList[pfrom->addr] = askAgain;
-            }
+            if (!CheckListRequest(pfrom))
+                return;
         } //else, asking for a specific node which is ok
 
         int nInvCount = 0;
 
-        for (CMasternode& mn : vMasternodes) {
+        for (auto& entry : mapMasternodes) {
+            CMasternode& mn = entry.second;
             if (mn.addr.IsRFC1918())
                 continue; //local network
 
@@ -721,20 +1044,184 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
 
         AskForMN(pfrom, vin, connman);
     }
+
+    else if (strCommand == NetMsgType::MNLISTDIGEST) {
+
+        std::vector<uint256> vDigestPeer;
+        vRecv >> vDigestPeer;
+
+        if (vDigestPeer.size() != MASTERNODES_DIGEST_BUCKETS) {
+            LogPrint(BCLog::MASTERNODE, "mnld - invalid digest size %u from peer %i\n", vDigestPeer.size(), pfrom->GetId());
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        // same allowance as a full dseg
+        if (!CheckListRequest(pfrom))
+            return;
+
+        int nInvCount = PushListEntries(pfrom, vDigestPeer);
+
+        connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, nInvCount));
+        LogPrint(BCLog::MASTERNODE, "mnld - Sent %d differing Masternode entries to peer %i\n", nInvCount, pfrom->GetId());
+    }
+}
+
+bool CMasternodeMan::PushPendingMessage(CMasternodePendingMessage& msg)
+{
+    boost::unique_lock<boost::mutex> lock(mutexPending);
+    if (queuePending.size() >= MASTERNODES_VERIFY_QUEUE_SIZE) {
+        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::PushPendingMessage() : verification queue is full, dropping %s from peer=%d\n", msg.fPing ? "mnp" : "mnb", msg.nodeId);
+        nPendingDropped++;
+        return false;
+    }
+    msg.nTimeReceived = GetTimeMicros();
+    queuePending.push_back(std::move(msg));
+    condPending.notify_one();
+    return true;
+}
+
+void CMasternodeMan::VerifyPendingSignatures(CMasternodePendingMessage& msg)
+{
+    // Only the valid signatures are kept in the signature cache, the checks
+    // made again under cs_main then skip the key recovery.
+    int nDos = 0;
+    if (msg.fPing) {
+        CPubKey pubKeyMasternode;
+        {
+            LOCK(cs);
+            auto it = mapMasternodes.find(msg.mnp.vin.prevout);
+            if (it != mapMasternodes.end())
+                pubKeyMasternode = it->second.pubKeyMasternode;
+        }
+        if (pubKeyMasternode.IsValid())
+            msg.mnp.VerifySignature(pubKeyMasternode, nDos);
+    } else {
+        std::string errorMessage;
+        msg.mnb.CheckAddressSignature(errorMessage);
+        if (msg.mnb.lastPing != CMasternodePing())
+            msg.mnb.lastPing.VerifySignature(msg.mnb.pubKeyMasternode, nDos);
+    }
+}
+
+void CMasternodeMan::ProcessBroadcast(NodeId nodeId, CMasternodeBroadcast& mnb, CConnman& connman)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_process_message);
+
+    int nDoS = 0;
+    if (!mnb.CheckAndUpdate(nDoS, connman)) {
+        if (nDoS > 0)
+            Misbehaving(nodeId, nDoS);
+
+        //failed
+        return;
+    }
+
+    // make sure the vout that was signed is related to the transaction that spawned the Masternode
+    //  - this is expensive, so it's only done once per Masternode
+    if (!masternodeSigner.IsVinAssociatedWithPubkey(mnb.vin, mnb.pubKeyCollateralAddress)) {
+        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::ProcessBroadcast() : mnb - Got mismatched pubkey and vin\n");
+        Misbehaving(nodeId, 33);
+        return;
+    }
+
+    // make sure it's still unspent
+    //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
+    if (mnb.CheckInputsAndAdd(nDoS, connman)) {
+        masternodeSync.AddedMasternodeList(mnb.GetHash());
+    } else {
+        LogPrint(BCLog::MASTERNODE, "mnb - Rejected Masternode entry %s\n", mnb.vin.prevout.hash.ToString());
+
+        if (nDoS > 0)
+            Misbehaving(nodeId, nDoS);
+    }
+}
+
+void CMasternodeMan::ProcessPing(NodeId nodeId, CMasternodePing& mnp, CConnman& connman)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_process_message);
+
+    int nDoS = 0;
+    if (mnp.CheckAndUpdate(nDoS, connman))
+        return;
+
+    if (nDoS > 0) {
+        Misbehaving(nodeId, nDoS);
+    } else {
+        CMasternode* pmn = Find(mnp.vin);
+        if (pmn)
+            return;
+    }
+
+    // something significant is broken or mn is unknown,
+    // we might have to ask for a masternode entry once
+    connman.ForNode(nodeId, [&](CNode* pnode) {
+        AskForMN(pnode, mnp.vin, connman);
+        return true;
+    });
+}
+
+void CMasternodeMan::ProcessPendingMessages(CConnman& connman)
+{
+    std::vector<CMasternodePendingMessage> vBatch;
+    {
+        boost::unique_lock<boost::mutex> lock(mutexPending);
+        while (queuePending.empty())
+            condPending.wait(lock);
+        while (!queuePending.empty() && vBatch.size() < MASTERNODES_VERIFY_BATCH_SIZE) {
+            vBatch.push_back(std::move(queuePending.front()));
+            queuePending.pop_front();
+        }
+    }
+
+    for (CMasternodePendingMessage& msg : vBatch)
+        VerifyPendingSignatures(msg);
+
+    // the collateral and block index lookups of the whole batch
+    {
+        LOCK2(cs_main, cs_process_message);
+        for (CMasternodePendingMessage& msg : vBatch) {
+            if (msg.fPing)
+                ProcessPing(msg.nodeId, msg.mnp, connman);
+            else
+                ProcessBroadcast(msg.nodeId, msg.mnb, connman);
+        }
+    }
+
+    const int64_t nTimeNow = GetTimeMicros();
+    boost::unique_lock<boost::mutex> lock(mutexPending);
+    for (const CMasternodePendingMessage& msg : vBatch) {
+        const int64_t nLatency = nTimeNow - msg.nTimeReceived;
+        nPendingLatencyTotal += nLatency;
+        nPendingLatencyMax = std::max(nPendingLatencyMax, nLatency);
+    }
+    nPendingProcessed += vBatch.size();
+    nPendingBatches++;
+}
+
+CMasternodeVerifyStats CMasternodeMan::GetVerifyStats()
+{
+    boost::unique_lock<boost::mutex> lock(mutexPending);
+    CMasternodeVerifyStats stats;
+    stats.nQueued = queuePending.size();
+    stats.nProcessed = nPendingProcessed;
+    stats.nDropped = nPendingDropped;
+    stats.nBatches = nPendingBatches;
+    stats.nAvgLatency = nPendingProcessed ? nPendingLatencyTotal / (int64_t)nPendingProcessed : 0;
+    stats.nMaxLatency = nPendingLatencyMax;
+    return stats;
 }
 
 void CMasternodeMan::Remove(CTxIn vin)
 {
     LOCK(cs);
 
-    std::vector<CMasternode>::iterator it = vMasternodes.begin();
-    while (it != vMasternodes.end()) {
-        if ((*it).vin == vin) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
-            vMasternodes.erase(it);
-            break;
-        }
-        ++it;
+    auto it = mapMasternodes.find(vin.prevout);
+    if (it != mapMasternodes.end() && it->second.vin == vin) {
+        LogPrint(BCLog::MASTERNODE, "CMasternodeMan: Removing Masternode %s - %i now\n", vin.prevout.hash.ToString(), size() - 1);
+        EraseMasternode(vin.prevout);
     }
 }
 
@@ -751,15 +1238,34 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
         CMasternode mn(mnb);
         Add(mn);
     } else {
-        pmn->UpdateFromNewBroadcast(mnb, connman);
+        UpdateFromNewBroadcast(*pmn, mnb, connman);
     }
 }
 
+bool CMasternodeMan::UpdateFromNewBroadcast(CMasternode& mn, CMasternodeBroadcast& mnb, CConnman& connman)
+{
+    LOCK(cs);
+
+    // the broadcast may carry new keys
+    RemoveFromIndex(mn);
+    bool fUpdated = mn.UpdateFromNewBroadcast(mnb, connman);
+    AddToIndex(mn);
+    if (fUpdated)
+        CheckMasternode(mn);
+    return fUpdated;
+}
+
 std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Masternodes: " << (int)vMasternodes.size() << ", peers who asked us for Masternode list: " << (int)mAskedUsForMasternodeList.size() << ", peers we asked for Masternode list: " << (int)mWeAskedForMasternodeList.size() << ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size();
+    info << "Masternodes: " << (int)mapMasternodes.size() << ", peers who asked us for Masternode list: " << (int)mAskedUsForMasternodeList.size() << ", peers we asked for Masternode list: " << (int)mWeAskedForMasternodeList.size() << ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size();
 
     return info.str();
 }
+
+void ThreadMasternodeVerify(CConnman& connman)
+{
+    while (true)
+        mnodeman.ProcessPendingMessages(connman);
+}
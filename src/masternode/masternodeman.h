@@ -15,9 +15,24 @@
 #include <sync.h>
 #include <util/system.h>
 #include <validation.h>
+#include <validationinterface.h>
+
+#include <deque>
+#include <set>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+//! Number of block heights the masternode score tables are kept for
+#define MASTERNODES_SCORE_TABLES 16
+//! Maximum number of received mnb/mnp messages waiting for verification
+#define MASTERNODES_VERIFY_QUEUE_SIZE 10000
+//! Maximum number of queued messages verified under one cs_main lock
+#define MASTERNODES_VERIFY_BATCH_SIZE 128
+//! Number of buckets of the masternode list digest, by the first byte of the collateral txid
+#define MASTERNODES_DIGEST_BUCKETS 256
 
 class CMasternodeMan;
 class CActiveMasternode;
@@ -25,7 +40,41 @@ class CActiveMasternode;
 extern CMasternodeMan mnodeman;
 extern CActiveMasternode activeMasternode;
 
-class CMasternodeMan {
+/** Salted hasher for the key ids the masternode list is indexed by */
+class SaltedKeyIDHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedKeyIDHasher();
+
+    size_t operator()(const CKeyID& id) const noexcept
+    {
+        return CSipHasher(k0, k1).Write(id.begin(), id.size()).Finalize();
+    }
+};
+
+/** A mnb or mnp received from a peer, waiting for verification */
+struct CMasternodePendingMessage {
+    NodeId nodeId;
+    int64_t nTimeReceived;
+    bool fPing;
+    CMasternodeBroadcast mnb;
+    CMasternodePing mnp;
+};
+
+/** Counters of the masternode message verification queue */
+struct CMasternodeVerifyStats {
+    uint64_t nQueued;
+    uint64_t nProcessed;
+    uint64_t nDropped;
+    uint64_t nBatches;
+    int64_t nAvgLatency; // microseconds
+    int64_t nMaxLatency; // microseconds
+};
+
+class CMasternodeMan : public CValidationInterface {
 private:
     // critical section to protect the inner data structures
     mutable RecursiveMutex cs;
@@ -33,8 +82,12 @@ private:
     // critical section to protect the inner data structures specifically on messaging
     mutable RecursiveMutex cs_process_message;
 
-    // map to hold all MNs
-    std::vector<CMasternode> vMasternodes;
+    // map to hold all MNs, by collateral outpoint. Entries are never moved,
+    // so pointers handed out by Find stay valid until the entry is removed.
+    std::unordered_map<COutPoint, CMasternode, SaltedOutpointHasher> mapMasternodes;
+    // MNs by the id of their masternode key and of their collateral key (payee)
+    std::unordered_multimap<CKeyID, COutPoint, SaltedKeyIDHasher> mapByMasternodeKey;
+    std::unordered_multimap<CKeyID, COutPoint, SaltedKeyIDHasher> mapByCollateralKey;
     // who's asked for the Masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the Masternode list and the last time
@@ -42,6 +95,60 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // compact scores of all MNs for the election at one height, best first
+    typedef std::vector<std::pair<int64_t, COutPoint>> MasternodeScores;
+    // score tables by height, with the block hash they were computed for.
+    // They only depend on the set of outpoints, so they are dropped when an
+    // entry is added or removed.
+    std::map<int64_t, std::pair<uint256, MasternodeScores>> mapScoreTables;
+
+    // state and protocol each MN is counted with, and the time its state
+    // changes unless it is pinged again (0: never)
+    struct CheckState {
+        int nState;
+        int nProtocol;
+        int64_t nDeadline;
+    };
+    std::unordered_map<COutPoint, CheckState, SaltedOutpointHasher> mapCheckStates;
+    // number of MNs by (activeState, protocolVersion)
+    std::map<std::pair<int, int>, int> mapStateCounts;
+    // MNs by the time their next state change is due
+    std::set<std::pair<int64_t, COutPoint>> setCheckDeadlines;
+    // MNs added, changed or removed since the last flush to the masternode store
+    std::set<COutPoint> setDirtyMasternodes;
+
+    void AddToIndex(const CMasternode& mn);
+    void RemoveFromIndex(const CMasternode& mn);
+    void UpdateCheckState(const CMasternode& mn);
+    void EraseCheckState(const COutPoint& outpoint);
+    void CheckDeadlines();
+    void EraseMasternode(const COutPoint& outpoint);
+    const MasternodeScores* GetScoreTable(int64_t nBlockHeight);
+    bool CheckListRequest(CNode* pfrom);
+    void ProcessListRequest(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+
+    // mnb and mnp messages waiting for ThreadMasternodeVerify, and its counters
+    boost::mutex mutexPending;
+    boost::condition_variable condPending;
+    std::deque<CMasternodePendingMessage> queuePending;
+    uint64_t nPendingProcessed = 0;
+    uint64_t nPendingDropped = 0;
+    uint64_t nPendingBatches = 0;
+    int64_t nPendingLatencyTotal = 0;
+    int64_t nPendingLatencyMax = 0;
+
+    bool PushPendingMessage(CMasternodePendingMessage& msg);
+    void VerifyPendingSignatures(CMasternodePendingMessage& msg);
+    void ProcessBroadcast(NodeId nodeId, CMasternodeBroadcast& mnb, CConnman& connman);
+    void ProcessPing(NodeId nodeId, CMasternodePing& mnp, CConnman& connman);
+
+    void SetCollateralSpent(CMasternode& mn, bool fSpent);
+
+protected:
+    // the list is keyed by collateral, blocks are only matched against it
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
+
 public:
     // Keep track of all broadcasts I've seen
     std::map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
@@ -58,7 +165,26 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
         LOCK(cs);
+        // stored as a plain list, as before the list was indexed
+        std::vector<CMasternode> vMasternodes;
+        if (!ser_action.ForRead())
+            vMasternodes = GetMasternodeVector();
         READWRITE(vMasternodes);
+        if (ser_action.ForRead()) {
+            mapMasternodes.clear();
+            mapByMasternodeKey.clear();
+            mapByCollateralKey.clear();
+            mapCheckStates.clear();
+            mapStateCounts.clear();
+            setCheckDeadlines.clear();
+            mapScoreTables.clear();
+            for (const CMasternode& mn : vMasternodes) {
+                if (mapMasternodes.emplace(mn.vin.prevout, mn).second) {
+                    AddToIndex(mn);
+                    UpdateCheckState(mn);
+                }
+            }
+        }
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
@@ -77,9 +203,22 @@ public:
     /// Ask (source) node for mnb
     void AskForMN(CNode* pnode, CTxIn& outpoint, CConnman& connman);
 
-    /// Check all Masternodes
+    /// Check the Masternodes whose state is due to change
     void Check();
 
+    /// Check one entry after its ping changed, keeping the counters in sync
+    void CheckMasternode(CMasternode& mn);
+
+    /// Mark the entries whose collateral is not in the UTXO set, once after loading the list
+    void CheckCollaterals();
+
+    /// Insert an entry read from the masternode store
+    void LoadMasternode(const CMasternode& mn);
+    /// Copies of the entries changed since the last call, and the outpoints of the removed ones
+    void GetChanges(std::vector<CMasternode>& vChanged, std::vector<COutPoint>& vRemoved);
+    /// Mark changes taken by GetChanges as unwritten again, after the flush failed
+    void MarkDirty(const std::vector<CMasternode>& vChanged, const std::vector<COutPoint>& vRemoved);
+
     /// Check all Masternodes and remove inactive
     void CheckAndRemove(bool forceExpiredRemoval = false);
 
@@ -91,6 +230,12 @@ public:
     void CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion);
 
     void DsegUpdate(CNode* pnode, CConnman& connman);
+    /// Ask for the masternodes that differ from our list, instead of the full list
+    void DigestUpdate(CNode* pnode, CConnman& connman);
+    /// Per-bucket digest of the entries handed out by dseg and mnld
+    void GetListDigest(std::vector<uint256>& vDigest);
+    /// Announce to pfrom the entries in the buckets where its digest differs from ours
+    int PushListEntries(CNode* pfrom, const std::vector<uint256>& vDigestPeer);
 
     /// Find an entry
     CMasternode* Find(const CScript& payee);
@@ -106,10 +251,13 @@ public:
     /// Get the current winner for this block
     CMasternode* GetCurrentMasterNode(int mod = 1, int64_t nBlockHeight = 0, int minProtocol = 0);
 
+    /// Copy of all masternodes in the list
+    std::vector<CMasternode> GetMasternodeVector() const;
+
     std::vector<CMasternode> GetFullMasternodeVector()
     {
         Check();
-        return vMasternodes;
+        return GetMasternodeVector();
     }
 
     std::vector<std::pair<int, CMasternode>> GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
@@ -117,10 +265,15 @@ public:
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+
+    /// Wait for queued mnb/mnp messages and verify one batch of them
+    void ProcessPendingMessages(CConnman& connman);
+    CMasternodeVerifyStats GetVerifyStats();
+
     void ProcessMasternodeConnections(CConnman& connman);
 
     /// Return the number of (unique) Masternodes
-    int size() { return vMasternodes.size(); }
+    int size() { return mapMasternodes.size(); }
 
     /// Return the number of Masternodes older than (default) 8000 seconds
     int stable_size();
@@ -133,6 +286,12 @@ public:
 
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& connman);
+
+    /// Update an entry of the list from a newer broadcast, keeping the indexes in sync
+    bool UpdateFromNewBroadcast(CMasternode& mn, CMasternodeBroadcast& mnb, CConnman& connman);
 };
 
+/** Verify the mnb and mnp messages queued by the net message handler */
+void ThreadMasternodeVerify(CConnman& connman);
+
 #endif
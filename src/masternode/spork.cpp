@@ -4,6 +4,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <flat-database.h>
 #include <key_io.h>
 #include <masternode/masternode-helpers.h>
 #include <masternode/spork.h>
@@ -32,6 +33,95 @@ static const int64_t SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT = 4070908800;
 static const int64_t SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT = 4070908800;
 static const int64_t SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2_DEFAULT = 4070908800;
 static const int64_t SPORK_16_CLIENT_COMPAT_MODE_DEFAULT = 4070908800;
+
+// value of a spork no signed message was accepted for, -1 if unknown
+static int64_t GetSporkDefault(int nSporkID)
+{
+    switch (nSporkID) {
+    case SPORK_5_MAX_VALUE:
+        return SPORK_5_MAX_VALUE_DEFAULT;
+    case SPORK_7_MASTERNODE_SCANNING:
+        return SPORK_7_MASTERNODE_SCANNING_DEFAULT;
+    case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:
+        return SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
+    case SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT:
+        return SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
+    case SPORK_10_MASTERNODE_PAY_UPDATED_NODES:
+        return SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT;
+    case SPORK_13_ENABLE_SUPERBLOCKS:
+        return SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
+    case SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2:
+        return SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2_DEFAULT;
+    case SPORK_16_CLIENT_COMPAT_MODE:
+        return SPORK_16_CLIENT_COMPAT_MODE_DEFAULT;
+    default:
+        return -1;
+    }
+}
+}
+
+// keep the accepted sporks so that the next start has them before syncing
+static void DumpSporks()
+{
+    CFlatDB<CSporkManager> flatdb("sporks.dat", "magicSporkCache");
+    flatdb.Dump(sporkManager);
+}
+
+CSporkManager::CSporkManager()
+{
+    ResetSporkValues();
+}
+
+void CSporkManager::ResetSporkValues()
+{
+    for (size_t i = 0; i < arrSporkValues.size(); i++)
+        arrSporkValues[i].store(Spork::GetSporkDefault(Spork::SPORK_START + i), std::memory_order_relaxed);
+}
+
+void CSporkManager::PublishSporkValue(int nSporkID, int64_t nValue)
+{
+    if (nSporkID >= Spork::SPORK_START && nSporkID < Spork::SPORK_END)
+        arrSporkValues[nSporkID - Spork::SPORK_START].store(nValue, std::memory_order_release);
+}
+
+void CSporkManager::SetSporkActive(const CSporkMessage& spork)
+{
+    AssertLockHeld(cs);
+
+    mapSporks[spork.GetHash()] = spork;
+    mapSporksActive[spork.nSporkID] = spork;
+    PublishSporkValue(spork.nSporkID, spork.nValue);
+}
+
+void CSporkManager::Clear()
+{
+    LOCK(cs);
+    mapSporksActive.clear();
+    ResetSporkValues();
+}
+
+void CSporkManager::CheckAndRemove()
+{
+    LOCK(cs);
+
+    ResetSporkValues();
+    auto it = mapSporksActive.begin();
+    while (it != mapSporksActive.end()) {
+        if (it->first != it->second.nSporkID || !it->second.CheckSignature()) {
+            LogPrint(BCLog::SPORK, "CSporkManager::CheckAndRemove -- invalid stored spork %d\n", it->first);
+            mapSporksActive.erase(it++);
+            continue;
+        }
+        mapSporks[it->second.GetHash()] = it->second;
+        PublishSporkValue(it->first, it->second.nValue);
+        ++it;
+    }
+}
+
+std::string CSporkManager::ToString() const
+{
+    LOCK(cs);
+    return strprintf("Sporks: %d", (int)mapSporksActive.size());
 }
 
 void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -55,15 +145,19 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
                 pfrom->GetId());
         }
 
-        if (mapSporksActive.count(spork.nSporkID)) {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
-                LogPrint(BCLog::SPORK, "%s seen\n", strLogMsg);
-                return;
+        {
+            LOCK(cs);
+            auto it = mapSporksActive.find(spork.nSporkID);
+            if (it != mapSporksActive.end()) {
+                if (it->second.nTimeSigned >= spork.nTimeSigned) {
+                    LogPrint(BCLog::SPORK, "%s seen\n", strLogMsg);
+                    return;
+                } else {
+                    LogPrint(BCLog::SPORK, "%s updated\n", strLogMsg);
+                }
             } else {
-                LogPrint(BCLog::SPORK, "%s updated\n", strLogMsg);
+                LogPrint(BCLog::SPORK, "%s new\n", strLogMsg);
             }
-        } else {
-            LogPrint(BCLog::SPORK, "%s new\n", strLogMsg);
         }
 
         if (!spork.CheckSignature()) {
@@ -73,21 +167,32 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             return;
         }
 
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        {
+            LOCK(cs);
+            // a newer one may have been accepted while the signature was checked
+            auto it = mapSporksActive.find(spork.nSporkID);
+            if (it != mapSporksActive.end() && it->second.nTimeSigned >= spork.nTimeSigned)
+                return;
+            SetSporkActive(spork);
+        }
         spork.Relay(connman);
 
         //does a task if needed
         ExecuteSpork(spork.nSporkID, spork.nValue);
+        DumpSporks();
 
     } else if (strCommand == NetMsgType::GETSPORKS) {
-        std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
+        std::vector<CSporkMessage> vSporks;
+        {
+            LOCK(cs);
+            for (const auto& entry : mapSporksActive)
+                vSporks.push_back(entry.second);
+        }
 
         const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
 
-        while (it != mapSporksActive.end()) {
-            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, it->second));
-            it++;
+        for (const CSporkMessage& spork : vSporks) {
+            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, spork));
         }
     }
 }
@@ -101,9 +206,12 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
     CSporkMessage spork = CSporkMessage(nSporkID, nValue, GetAdjustedTime());
 
     if (spork.Sign(strMasterPrivKey)) {
+        {
+            LOCK(cs);
+            SetSporkActive(spork);
+        }
         spork.Relay(connman);
-        mapSporks[spork.GetHash()] = spork;
-        mapSporksActive[nSporkID] = spork;
+        DumpSporks();
         return true;
     }
 
@@ -122,32 +230,11 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
-    if (mapSporksActive.count(nSporkID))
-        return mapSporksActive[nSporkID].nValue;
+    if (nSporkID >= Spork::SPORK_START && nSporkID < Spork::SPORK_END)
+        return arrSporkValues[nSporkID - Spork::SPORK_START].load(std::memory_order_acquire);
 
-    using namespace Spork;
-
-    switch (nSporkID) {
-    case SPORK_5_MAX_VALUE:
-        return SPORK_5_MAX_VALUE_DEFAULT;
-    case SPORK_7_MASTERNODE_SCANNING:
-        return SPORK_7_MASTERNODE_SCANNING_DEFAULT;
-    case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:
-        return SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-    case SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT:
-        return SPORK_9_MASTERNODE_BUDGET_ENFORCEMENT_DEFAULT;
-    case SPORK_10_MASTERNODE_PAY_UPDATED_NODES:
-        return SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT;
-    case SPORK_13_ENABLE_SUPERBLOCKS:
-        return SPORK_13_ENABLE_SUPERBLOCKS_DEFAULT;
-    case SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2:
-        return SPORK_15_NEW_PROTOCOL_ENFORCEMENT_2_DEFAULT;
-    case SPORK_16_CLIENT_COMPAT_MODE:
-        return SPORK_16_CLIENT_COMPAT_MODE_DEFAULT;
-    default:
-        LogPrint(BCLog::SPORK, "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
-        return -1;
-    }
+    LogPrint(BCLog::SPORK, "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
+    return -1;
 }
 
 int CSporkManager::GetSporkIDByName(std::string strName)
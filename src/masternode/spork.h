@@ -9,8 +9,12 @@
 
 #include <hash.h>
 #include <net.h>
+#include <sync.h>
 #include <util/strencodings.h>
 
+#include <array>
+#include <atomic>
+
 class CSporkMessage;
 class CSporkManager;
 
@@ -88,14 +92,39 @@ public:
 };
 
 class CSporkManager {
+public:
+    mutable RecursiveMutex cs;
+
 private:
     std::vector<unsigned char> vchSig;
     std::string strMasterPrivKey;
-    std::map<int, CSporkMessage> mapSporksActive;
+    // latest accepted message of each spork
+    std::map<int, CSporkMessage> mapSporksActive GUARDED_BY(cs);
+    // values of the sporks from SPORK_START to SPORK_END, read without locking;
+    // only written, under cs, when a newer signed message is accepted
+    std::array<std::atomic<int64_t>, Spork::SPORK_END - Spork::SPORK_START> arrSporkValues;
+
+    void SetSporkActive(const CSporkMessage& spork) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void PublishSporkValue(int nSporkID, int64_t nValue);
+    void ResetSporkValues();
 
 public:
     using Executor = std::function<void(void)>;
-    CSporkManager() {}
+    CSporkManager();
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        LOCK(cs);
+        READWRITE(mapSporksActive);
+        if (ser_action.ForRead()) {
+            ResetSporkValues();
+            for (const auto& entry : mapSporksActive)
+                PublishSporkValue(entry.first, entry.second.nValue);
+        }
+    }
 
     void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
     void ExecuteSpork(int nSporkID, int nValue);
@@ -107,6 +136,12 @@ public:
     std::string GetSporkNameByID(int id);
 
     bool SetPrivKey(std::string strPrivKey);
+
+    /// Forget all sporks and go back to the defaults
+    void Clear();
+    /// Drop loaded sporks whose signature does not check out
+    void CheckAndRemove();
+    std::string ToString() const;
 };
 
 #endif
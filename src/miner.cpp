@@ -7,6 +7,7 @@
 #include <miner.h>
 
 #include <amount.h>
+#include <arith_uint256.h>
 #include <blocksignature.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -15,6 +16,7 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/argon2m.h>
 #include <masternode/masternodeman.h>
 #include <masternode/masternode-sync.h>
 #include <policy/feerate.h>
@@ -23,14 +25,17 @@
 #include <primitives/transaction.h>
 #include <script/standard.h>
 #include <shutdown.h>
+#include <sync.h>
 #include <timedata.h>
 #include <util/moneystr.h>
 #include <util/system.h>
 #include <util/validation.h>
+#include <validationinterface.h>
 #include <wallet/stake.h>
 #include <wallet/wallet.h>
 
 #include <algorithm>
+#include <atomic>
 #include <utility>
 
 #include <boost/thread.hpp>
@@ -99,9 +104,10 @@ void BlockAssembler::resetBlock()
 Optional<int64_t> BlockAssembler::m_last_block_num_txs{nullopt};
 Optional<int64_t> BlockAssembler::m_last_block_weight{nullopt};
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fProofOfStake)
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, const CBlockStake* pstake)
 {
     int64_t nTimeStart = GetTimeMicros();
+    const bool fProofOfStake = pstake != nullptr;
 
     resetBlock();
 
@@ -121,6 +127,8 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     LOCK2(cs_main, m_mempool.cs);
     CBlockIndex* pindexPrev = ::ChainActive().Tip();
     assert(pindexPrev != nullptr);
+    if (fProofOfStake && pindexPrev->GetBlockHash() != pstake->hashPrevBlock)
+        return nullptr;
     nHeight = pindexPrev->nHeight + 1;
 
     pblock->nVersion = IsLegacyMode() ? 3 : ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
@@ -156,9 +164,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     m_last_block_num_txs = nBlockTx;
     m_last_block_weight = nBlockWeight;
 
-    // Grab wallet
-    const auto m_wallet = GetMainWallet();
-
     // Create coinbase transaction.
     CMutableTransaction coinbaseTx;
     coinbaseTx.vin.resize(1);
@@ -167,28 +172,10 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
 
     // ppcoin: if coinstake available add coinstake tx
-    static int64_t m_last_coin_stake_search_time = GetAdjustedTime();
-
-    if(fProofOfStake)
-    {
-        boost::this_thread::interruption_point();
-        pblock->nBits = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
-        CMutableTransaction coinstakeTx;
-        int64_t nSearchTime = pblock->nTime;
-        bool fStakeFound = false;
-        if (nSearchTime >= m_last_coin_stake_search_time) {
-            unsigned int nTxNewTime = 0;
-            if (stake.CreateCoinStake(pblock->nBits, coinstakeTx, nTxNewTime)) {
-                pblock->nTime = nTxNewTime;
-                coinbaseTx.vout[0].SetEmpty();
-                pblock->vtx[1] = MakeTransactionRef(std::move(coinstakeTx));
-                fStakeFound = true;
-            }
-            m_wallet->m_last_coin_stake_search_interval = nSearchTime - m_last_coin_stake_search_time;
-            m_last_coin_stake_search_time = nSearchTime;
-        }
-        if (!fStakeFound)
-            return nullptr;
+    if (fProofOfStake) {
+        pblock->nTime = pstake->nTime;
+        coinbaseTx.vout[0].SetEmpty();
+        pblock->vtx[1] = pstake->coinstake;
     }
 
     // Compute final coinbase transaction.
@@ -479,6 +466,11 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
         hashPrevBlock = pblock->hashPrevBlock;
     }
     ++nExtraNonce;
+    SetExtraNonce(pblock, pindexPrev, nExtraNonce);
+}
+
+void SetExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int nExtraNonce)
+{
     unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
     CMutableTransaction txCoinbase(*pblock->vtx[0]);
     txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CScriptNum(nExtraNonce));
@@ -488,6 +480,112 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
 
+// nNonce is the last field of the header.
+static const size_t HEADER_NONCE_OFFSET = BLOCK_HEADER_SIZE - sizeof(uint32_t);
+
+CPoWSearch::CPoWSearch(const CBlockHeader& header)
+{
+    UpdateTime(header);
+}
+
+void CPoWSearch::UpdateTime(const CBlockHeader& header)
+{
+    // Same bytes GetUncachedHash() feeds to argon2m.
+    memcpy(m_header, &header.nVersion, BLOCK_HEADER_SIZE);
+}
+
+bool CPoWSearch::Scan(uint32_t& nNonce, uint32_t nCount, const arith_uint256& hashTarget, uint256& hash)
+{
+    for (; nCount > 0; --nCount, ++nNonce) {
+        memcpy(m_header + HEADER_NONCE_OFFSET, &nNonce, sizeof(nNonce));
+        Argon2mHash(m_header, hash.begin());
+        if (UintToArith256(hash) <= hashTarget)
+            return true;
+    }
+    return false;
+}
+
+// Hash rates are averaged over windows of at least this many microseconds.
+static const int64_t MINER_RATE_WINDOW = 5 * 1000 * 1000;
+// Longest the stake minter sleeps, in milliseconds, while it cannot stake.
+static const int64_t STAKE_MINTER_IDLE_WAIT = 5 * 1000;
+
+namespace {
+/** Hash counters of one proof-of-work thread, updated by that thread only. */
+struct MinerThreadStats
+{
+    std::atomic<uint64_t> nHashes{0};
+    std::atomic<double> dHashesPerSec{0};
+};
+
+Mutex cs_minerStats;
+std::vector<std::shared_ptr<MinerThreadStats>> vMinerStats GUARDED_BY(cs_minerStats);
+
+/**
+ * Wakes the stake minter when a search may find something new: a new tip
+ * or a change to the wallet. Between those the minter blocks here until
+ * the adjusted time reaches a timestamp its last search did not cover.
+ */
+class CStakeScheduler final : public CValidationInterface
+{
+public:
+    void Notify()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            fWake = true;
+        }
+        cond.notify_all();
+    }
+
+    /** Forget earlier events, as a search is about to start from the current tip */
+    void Reset()
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        fWake = false;
+    }
+
+    /** Block until notified or until nWakeTime (adjusted time in milliseconds). Interruptible. */
+    void WaitUntil(int64_t nWakeTime)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!fWake) {
+            const int64_t nWait = nWakeTime - (GetTimeMillis() + GetTimeOffset() * 1000);
+            if (nWait <= 0)
+                break;
+            cond.timed_wait(lock, boost::posix_time::milliseconds(std::min(nWait, STAKE_MINTER_IDLE_WAIT)));
+        }
+        fWake = false;
+    }
+
+    void WaitFor(int64_t nMillis) { WaitUntil(GetTimeMillis() + GetTimeOffset() * 1000 + nMillis); }
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override
+    {
+        Notify();
+    }
+
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fWake{false};
+};
+
+CStakeScheduler stakeScheduler;
+} // namespace
+
+std::vector<MinerThreadInfo> GetMinerThreadInfo()
+{
+    LOCK(cs_minerStats);
+    std::vector<MinerThreadInfo> ret;
+    ret.reserve(vMinerStats.size());
+    for (size_t i = 0; i < vMinerStats.size(); ++i) {
+        ret.push_back(MinerThreadInfo{(int)i, vMinerStats[i]->nHashes.load(), vMinerStats[i]->dHashesPerSec.load()});
+    }
+    return ret;
+}
+
 static bool ProcessBlockFound(const std::shared_ptr<const CBlock> &pblock, const CChainParams& chainparams)
 {
     if (pblock->hashPrevBlock != ::ChainActive().Tip()->GetBlockHash())
@@ -500,12 +598,21 @@ static bool ProcessBlockFound(const std::shared_ptr<const CBlock> &pblock, const
     return true;
 }
 
-void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWallet* pwallet, bool fProofOfStake)
+void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, std::shared_ptr<CWallet> pwallet, bool fProofOfStake,
+                         int nThread = 0, int nThreads = 1, std::shared_ptr<MinerThreadStats> stats = nullptr)
 {
-    LogPrintf("CPUMiner started for proof-of-stake\n");
+    LogPrintf("CPUMiner started for %s\n", fProofOfStake ? "proof-of-stake" : "proof-of-work");
     util::ThreadRename("bitcoin-miner");
 
+    // Thread nThread of nThreads uses extranonces nThread + k * nThreads
+    // and the nThread-th slice of the nonce space.
     unsigned int nExtraNonce = 0;
+    uint256 hashExtraNoncePrev;
+    const uint64_t nNonceBegin = ((uint64_t)1 << 32) * nThread / nThreads;
+    const uint64_t nNonceEnd = ((uint64_t)1 << 32) * (nThread + 1) / nThreads;
+    int64_t nRateWindowStart = GetTimeMicros();
+    uint64_t nRateWindowHashes = 0;
+    int64_t nLastCoinStakeSearchTime = GetAdjustedTime();
 
     CScript coinbaseScript;
     pwallet->GetScriptForMining(coinbaseScript);
@@ -517,7 +624,8 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
 
         try {
 
-            MilliSleep(100);
+            if (!fProofOfStake)
+                MilliSleep(100);
 
             // Throw an error if no script was provided.  This can happen
             // due to some internal error but also if the keypool is empty.
@@ -531,7 +639,17 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                     break;
                 if (ShutdownRequested())
                     return;
-                MilliSleep(1000);
+                boost::this_thread::interruption_point();
+                if (stats) {
+                    // Not hashing: restart the rate window once work resumes.
+                    stats->dHashesPerSec = 0;
+                    nRateWindowStart = GetTimeMicros();
+                    nRateWindowHashes = 0;
+                }
+                if (fProofOfStake)
+                    stakeScheduler.WaitFor(STAKE_MINTER_IDLE_WAIT);
+                else
+                    MilliSleep(1000);
             } while (true);
 
             if(fProofOfStake)
@@ -541,7 +659,7 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                     if (ShutdownRequested())
                         return;
                     pwallet->m_last_coin_stake_search_interval = 0;
-                    MilliSleep(1000);
+                    stakeScheduler.WaitFor(STAKE_MINTER_IDLE_WAIT);
                     continue;
                 }
             }
@@ -554,14 +672,50 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
             if(!pindexPrev) break;
 
             BlockAssembler assembler(mempool, chainparams);
-            auto pblocktemplate = assembler.CreateNewBlock(coinbaseScript, fProofOfStake);
+            std::unique_ptr<CBlockTemplate> pblocktemplate;
+            if (fProofOfStake) {
+                // Search for a kernel first, holding neither cs_main nor the
+                // mempool lock, and only assemble a block around a stake found.
+                stakeScheduler.Reset();
+                unsigned int nBits;
+                {
+                    LOCK(cs_main);
+                    pindexPrev = ::ChainActive().Tip();
+                    nBits = GetNextWorkRequired(pindexPrev, nullptr, chainparams.GetConsensus());
+                }
+                boost::this_thread::interruption_point();
+                CMutableTransaction coinstakeTx;
+                CBlockStake blockStake;
+                int64_t nSearchTime = GetAdjustedTime();
+                bool fStakeFound = stake.CreateCoinStake(pindexPrev, nBits, coinstakeTx, blockStake.nTime);
+                pwallet->m_last_coin_stake_search_interval = nSearchTime - nLastCoinStakeSearchTime;
+                nLastCoinStakeSearchTime = nSearchTime;
+                if (fStakeFound) {
+                    blockStake.coinstake = MakeTransactionRef(std::move(coinstakeTx));
+                    blockStake.hashPrevBlock = pindexPrev->GetBlockHash();
+                    pblocktemplate = assembler.CreateNewBlock(coinbaseScript, &blockStake);
+                }
+                if (!pblocktemplate) {
+                    // Timestamps are whole seconds: the next one the search
+                    // can reach only appears once the adjusted time moves on.
+                    stakeScheduler.WaitUntil((nSearchTime + 1) * 1000);
+                    continue;
+                }
+            } else {
+                pblocktemplate = assembler.CreateNewBlock(coinbaseScript);
+            }
             if (!pblocktemplate.get()) {
                 MilliSleep(500);
                 continue;
             }
 
             auto pblock = std::make_shared<CBlock>(pblocktemplate->block);
-            IncrementExtraNonce(pblock.get(), pindexPrev, nExtraNonce);
+            if (hashExtraNoncePrev != pblock->hashPrevBlock) {
+                hashExtraNoncePrev = pblock->hashPrevBlock;
+                nExtraNonce = nThread;
+            }
+            nExtraNonce += nThreads;
+            SetExtraNonce(pblock.get(), pindexPrev, nExtraNonce);
 
             LogPrintf("HODLminer -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
                       ::GetSerializeSize(*pblock, PROTOCOL_VERSION));
@@ -596,27 +750,37 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
             //
             int64_t nStart = GetTime();
             arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
+            CPoWSearch search(*pblock);
+            uint64_t nNonce = nNonceBegin;
             while (true)
             {
-                unsigned int nHashesDone = 0;
-
+                const uint32_t nCount = std::min<uint64_t>(MINER_SCAN_BATCH, nNonceEnd - nNonce);
+                uint32_t nNonceFound = nNonce;
                 uint256 hash;
-                while (true)
-                {
-                    hash = pblock->GetHash();
-                    if (UintToArith256(hash) <= hashTarget)
-                    {
-                        // Found a solution
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                        LogPrintf("HODLminer:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), hashTarget.GetHex());
-                        ProcessBlockFound(pblock, chainparams);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        break;
+                const bool fFound = search.Scan(nNonceFound, nCount, hashTarget, hash);
+                const uint64_t nHashesDone = fFound ? nNonceFound - nNonce + 1 : nCount;
+                nNonce += nHashesDone;
+
+                if (stats) {
+                    stats->nHashes += nHashesDone;
+                    nRateWindowHashes += nHashesDone;
+                    const int64_t nNow = GetTimeMicros();
+                    if (nNow - nRateWindowStart >= MINER_RATE_WINDOW) {
+                        stats->dHashesPerSec = nRateWindowHashes * 1e6 / (nNow - nRateWindowStart);
+                        nRateWindowStart = nNow;
+                        nRateWindowHashes = 0;
                     }
-                    pblock->nNonce += 1;
-                    nHashesDone += 1;
-                    if ((pblock->nNonce & 0xFF) == 0)
-                        break;
+                }
+
+                if (fFound)
+                {
+                    // Found a solution
+                    pblock->nNonce = nNonceFound;
+                    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+                    LogPrintf("HODLminer:\n  proof-of-work found\n  hash: %s\n  target: %s\n", hash.GetHex(), hashTarget.GetHex());
+                    ProcessBlockFound(pblock, chainparams);
+                    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                    break;
                 }
 
                 // Check for stop or if block needs to be rebuilt
@@ -624,7 +788,7 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                 // Regtest mode doesn't require peers
                 if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
                     break;
-                if (pblock->nNonce >= 0xffff0000)
+                if (nNonce >= nNonceEnd)
                     break;
                 if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
                     break;
@@ -634,6 +798,8 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, CWa
                 // Update nTime every few seconds
                 if (UpdateTime(pblock.get(), chainparams.GetConsensus(), pindexPrev) < 0)
                     break;
+                search.UpdateTime(*pblock);
+                hashTarget.SetCompact(pblock->nBits);
             }
         }
         catch (const boost::thread_interrupted&)
@@ -658,18 +824,30 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
     if (minerThreads != nullptr)
     {
         minerThreads->interrupt_all();
+        minerThreads->join_all();
         delete minerThreads;
         minerThreads = nullptr;
     }
 
+    LOCK(cs_minerStats);
+    vMinerStats.clear();
+
     if (nThreads == 0 || !fGenerate)
         return;
 
+    // Each thread keeps its own reference, so the wallet outlives an unload
+    // until the miners are stopped
     auto pwalletMain = GetMainWallet();
+    if (!pwalletMain) {
+        LogPrintf("GenerateBitcoins: no wallet loaded, not starting miner threads\n");
+        return;
+    }
 
     minerThreads = new boost::thread_group();
-    for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman), pwalletMain.get(), false));
+    for (int i = 0; i < nThreads; i++) {
+        vMinerStats.push_back(std::make_shared<MinerThreadStats>());
+        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman), pwalletMain, false, i, nThreads, vMinerStats.back()));
+    }
 }
 
 void ThreadStakeMinter(const CChainParams &chainparams, CConnman &connman)
@@ -679,14 +857,22 @@ void ThreadStakeMinter(const CChainParams &chainparams, CConnman &connman)
         return;
     LogPrintf("ThreadStakeMinter started\n");
     auto pwalletMain = GetMainWallet();
+    if (!pwalletMain) {
+        LogPrintf("ThreadStakeMinter: no wallet loaded, not staking\n");
+        return;
+    }
+    RegisterValidationInterface(&stakeScheduler);
+    boost::signals2::scoped_connection statusChanged = pwalletMain->NotifyStatusChanged.connect([](CWallet*) { stakeScheduler.Notify(); });
+    boost::signals2::scoped_connection transactionChanged = pwalletMain->NotifyTransactionChanged.connect([](CWallet*, const uint256&, ChangeType) { stakeScheduler.Notify(); });
     try {
         pwalletMain->setStakingFlag(true);
-        BitcoinMiner(chainparams, connman, pwalletMain.get(), true);
+        BitcoinMiner(chainparams, connman, pwalletMain, true);
         boost::this_thread::interruption_point();
     } catch (std::exception& e) {
         LogPrintf("ThreadStakeMinter() exception %s\n", e.what());
     } catch (...) {
         LogPrintf("ThreadStakeMinter() error \n");
     }
+    UnregisterValidationInterface(&stakeScheduler);
     pwalletMain->setStakingFlag(false);
 }
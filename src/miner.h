@@ -13,10 +13,12 @@
 
 #include <memory>
 #include <stdint.h>
+#include <vector>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
+class arith_uint256;
 class CBlockIndex;
 class CChainParams;
 class CScript;
@@ -25,6 +27,10 @@ class CWallet;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+static const bool DEFAULT_GENERATE = false;
+static const int DEFAULT_GENERATE_THREADS = 1;
+/** Number of nonces a proof-of-work thread tries between checks for a stale template */
+static const uint32_t MINER_SCAN_BATCH = 256;
 
 extern int64_t nLastCoinStakeSearchInterval;
 
@@ -36,6 +42,14 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCoinbaseCommitment;
 };
 
+/** A coinstake found by the kernel search, and the tip it was found on */
+struct CBlockStake
+{
+    CTransactionRef coinstake;
+    uint256 hashPrevBlock;
+    unsigned int nTime{0};
+};
+
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
 struct CTxMemPoolModifiedEntry {
@@ -162,8 +176,9 @@ public:
     explicit BlockAssembler(const CTxMemPool& mempool, const CChainParams& params);
     explicit BlockAssembler(const CTxMemPool& mempool, const CChainParams& params, const Options& options);
 
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
-    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fProofOfStake = false);
+    /** Construct a new block template with coinbase to scriptPubKeyIn, staked by pstake if given.
+     *  Returns nullptr if the tip has moved away from the one the stake was found on. */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, const CBlockStake* pstake = nullptr);
 
     static Optional<int64_t> m_last_block_num_txs;
     static Optional<int64_t> m_last_block_weight;
@@ -202,11 +217,54 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs);
 };
 
+/**
+ * Nonce search over a block header. The header is serialized once; each
+ * attempt only patches nNonce and runs argon2m on the buffer, bypassing the
+ * header hash caches that GetHash() would fill with losing nonces.
+ */
+class CPoWSearch
+{
+public:
+    explicit CPoWSearch(const CBlockHeader& header);
+
+    /** Pick up a new nTime/nBits after UpdateTime(). */
+    void UpdateTime(const CBlockHeader& header);
+
+    /**
+     * Try nonces [nNonce, nNonce + nCount). Returns true and leaves nNonce
+     * and hash at the first solution at or below hashTarget; otherwise
+     * returns false with nNonce just past the range.
+     */
+    bool Scan(uint32_t& nNonce, uint32_t nCount, const arith_uint256& hashTarget, uint256& hash);
+
+private:
+    unsigned char m_header[BLOCK_HEADER_SIZE];
+};
+
+/** Hashing statistics of one proof-of-work thread */
+struct MinerThreadInfo
+{
+    int nThread;
+    uint64_t nHashes;
+    double dHashesPerSec;
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
+/** Set the extranonce of a block's coinbase and update its merkle root */
+void SetExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
 /** Minting thread */
 void ThreadStakeMinter(const CChainParams &chainparams, CConnman &connman);
 
+/**
+ * Start (or stop, with fGenerate false) the proof-of-work threads. Each
+ * thread owns a disjoint slice of the nonce space and a disjoint extranonce
+ * sequence, so no two threads ever hash the same header.
+ */
+void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman &connman);
+/** Snapshot of the running proof-of-work threads' hash rates */
+std::vector<MinerThreadInfo> GetMinerThreadInfo();
+
 #endif // BITCOIN_MINER_H
@@ -35,7 +35,7 @@ bool AlreadyHaveMasternodeTypes(const CInv& inv, const CTxMemPool& mempool)
         case MSG_SPORK:
             return mapSporks.count(inv.hash);
         case MSG_MASTERNODE_WINNER:
-            if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
+            if (masternodePayments.HasVote(inv.hash)) {
                 masternodeSync.AddedMasternodeWinner(inv.hash);
                 return true;
             }
@@ -65,8 +65,9 @@ void ProcessGetDataMasternodeTypes(CNode* pfrom, const CChainParams& chainparams
     }
 
     if (!push && inv.type == MSG_MASTERNODE_WINNER) {
-        if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNWINNER, masternodePayments.mapMasternodePayeeVotes[inv.hash]));
+        CMasternodePaymentWinner winner;
+        if (masternodePayments.GetVote(inv.hash, winner)) {
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNWINNER, winner));
             push = true;
         }
     }
@@ -1683,6 +1683,10 @@ bool static ProcessHeadersMessage(CNode* pfrom, CConnman* connman, CTxMemPool& m
         return true;
     }
 
+    // Hash the whole batch on the worker threads before taking cs_main; the
+    // continuity and header checks below then reuse the memoized hashes.
+    PrecomputeHeaderHashes(headers);
+
     bool received_new_header = false;
     const CBlockIndex *pindexLast = nullptr;
     {
@@ -4,68 +4,182 @@
 
 #include <pos/cache.h>
 
+#include <chain.h>
 #include <chainparams.h>
 #include <pos/kernel.h>
 #include <timedata.h>
 #include <util/system.h>
 #include <validation.h>
 
-int cacheHit, cacheMiss, cacheLastCleared;
-std::unordered_map<unsigned int, uint64_t> cachedModifiers;
+std::atomic<uint64_t> cacheHit{0};
+std::atomic<uint64_t> cacheMiss{0};
+CStakeModifierIndex stakeModifiers;
+CStakeSeen stakeSeen;
 
-void InitSmartstakeCache()
+/**
+ * Walk the active chain forward from pindexFrom to the first block that
+ * generated a modifier a selection interval later. If the tip comes first,
+ * the latest modifier found is used and pindexModifier is left null, as the
+ * value may still change.
+ */
+static bool ComputeKernelStakeModifier(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, const CBlockIndex*& pindexModifier) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    cacheHit = 0;
-    cacheMiss = 0;
-    cacheLastCleared = GetAdjustedTime();
-    cachedModifiers.clear();
+    nStakeModifier = 0;
+    pindexModifier = nullptr;
+
+    auto nTimeBlockFrom = pindexFrom->GetBlockTime();
+    nStakeModifierHeight = pindexFrom->nHeight;
+    nStakeModifierTime = pindexFrom->GetBlockTime();
+    int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
+    const CBlockIndex* pindex = pindexFrom;
+    const CBlockIndex* pindexNext = ::ChainActive()[pindexFrom->nHeight + 1];
+
+    while (nStakeModifierTime < nTimeBlockFrom + nStakeModifierSelectionInterval) {
+        if (!pindexNext) {
+            if (nStakeModifier)
+                return true;
+            return error("%s : no stake modifier generated after block %s", __func__, pindexFrom->GetBlockHash().ToString());
+        }
+        pindex = pindexNext;
+        pindexNext = ::ChainActive()[pindexNext->nHeight + 1];
+        if (pindex->GeneratedStakeModifier()) {
+            nStakeModifierHeight = pindex->nHeight;
+            nStakeModifierTime = pindex->GetBlockTime();
+            nStakeModifier = pindex->nStakeModifier;
+            pindexModifier = pindex;
+        }
+    }
+
+    return true;
 }
 
-void MaintainSmartstakeCache()
+void CStakeModifierIndex::AddBlock(const CBlockIndex* pindex)
 {
-    int nowTime = GetAdjustedTime();
-    if (cacheLastCleared + FLUSH_POLICY < nowTime) {
-        LogPrintf("%s : cleared cache records (%d hit %d miss of %d total)\n", __func__, cacheHit, cacheMiss, cachedModifiers.size());
-        InitSmartstakeCache();
+    if (pindex->GeneratedStakeModifier()) {
+        const auto end = mapPending.upper_bound(pindex->GetBlockTime());
+        for (auto it = mapPending.begin(); it != end; ++it) {
+            vEntries[it->second].nStakeModifier = pindex->nStakeModifier;
+            vEntries[it->second].pindexModifier = pindex;
+        }
+        mapPending.erase(mapPending.begin(), end);
     }
+
+    // Heights skipped while the table was not being fed are left
+    // unresolved; Get() computes them on demand.
+    vEntries.resize(pindex->nHeight + 1);
+    vEntries[pindex->nHeight] = Entry();
+    mapPending.emplace(pindex->GetBlockTime() + GetStakeModifierSelectionInterval(), pindex->nHeight);
 }
 
-bool GetSmartstakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime)
+void CStakeModifierIndex::BlockConnected(const CBlockIndex* pindex)
 {
-    nStakeModifier = 0;
+    LOCK(cs);
+    AddBlock(pindex);
+}
 
-    if (!::BlockIndex().count(hashBlockFrom))
-        return error("GetKernelStakeModifier() : block not indexed");
+void CStakeModifierIndex::BlockDisconnected(const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    if ((int)vEntries.size() > pindex->nHeight)
+        vEntries.resize(pindex->nHeight);
+    for (auto it = mapPending.begin(); it != mapPending.end();) {
+        if (it->second >= pindex->nHeight)
+            it = mapPending.erase(it);
+        else
+            ++it;
+    }
+}
 
-    const CBlockIndex* pindexFrom = ::BlockIndex()[hashBlockFrom];
-    auto nTimeBlockFrom = pindexFrom->GetBlockTime();
-    nStakeModifierHeight = pindexFrom->nHeight;
-    nStakeModifierTime = pindexFrom->GetBlockTime();
-    int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
-    const CBlockIndex* pindex = pindexFrom;
-    CBlockIndex* pindexNext = ::ChainActive()[pindexFrom->nHeight + 1];
+void CStakeModifierIndex::Rebuild(const CChain& chain)
+{
+    LOCK(cs);
+    vEntries.clear();
+    mapPending.clear();
+    vEntries.reserve(chain.Height() + 1);
+    for (int nHeight = 0; nHeight <= chain.Height(); ++nHeight)
+        AddBlock(chain[nHeight]);
+}
 
-    MaintainSmartstakeCache();
+bool CStakeModifierIndex::Get(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime)
+{
+    AssertLockHeld(cs_main);
 
-    if (cachedModifiers.find(nTimeBlockFrom) != cachedModifiers.end()) {
-        nStakeModifier = cachedModifiers[nTimeBlockFrom];
-        ++cacheHit;
-    } else {
-        while (nStakeModifierTime < nTimeBlockFrom + nStakeModifierSelectionInterval) {
-            if (!pindexNext && nStakeModifier)
+    const bool fActive = ::ChainActive().Contains(pindexFrom);
+    if (fActive) {
+        LOCK(cs);
+        if (pindexFrom->nHeight < (int)vEntries.size()) {
+            const Entry& entry = vEntries[pindexFrom->nHeight];
+            if (entry.pindexModifier && ::ChainActive().Contains(entry.pindexModifier)) {
+                nStakeModifier = entry.nStakeModifier;
+                nStakeModifierHeight = entry.pindexModifier->nHeight;
+                nStakeModifierTime = entry.pindexModifier->GetBlockTime();
+                ++cacheHit;
                 return true;
-            pindex = pindexNext;
-            pindexNext = ::ChainActive()[pindexNext->nHeight + 1];
-            if (pindex->GeneratedStakeModifier()) {
-                nStakeModifierHeight = pindex->nHeight;
-                nStakeModifierTime = pindex->GetBlockTime();
-                nStakeModifier = pindex->nStakeModifier;
             }
         }
-        ++cacheMiss;
-        cachedModifiers.insert(std::make_pair(nTimeBlockFrom, nStakeModifier));
     }
 
+    ++cacheMiss;
+    const CBlockIndex* pindexModifier;
+    if (!ComputeKernelStakeModifier(pindexFrom, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, pindexModifier))
+        return false;
+
+    if (fActive && pindexModifier) {
+        LOCK(cs);
+        if (pindexFrom->nHeight < (int)vEntries.size()) {
+            vEntries[pindexFrom->nHeight].nStakeModifier = nStakeModifier;
+            vEntries[pindexFrom->nHeight].pindexModifier = pindexModifier;
+        }
+    }
     return true;
 }
 
+size_t CStakeModifierIndex::Size() const
+{
+    LOCK(cs);
+    return vEntries.size();
+}
+
+bool CStakeSeen::IsDuplicate(const Kernel& kernel, const uint256& hashBlock) const
+{
+    LOCK(cs);
+    auto it = mapKernels.find(kernel);
+    return it != mapKernels.end() && it->second.hashBlock != hashBlock;
+}
+
+void CStakeSeen::Add(const Kernel& kernel, const uint256& hashBlock, int nHeight, int nMinHeight)
+{
+    LOCK(cs);
+    while (!mapHeights.empty() && mapHeights.begin()->first < nMinHeight) {
+        mapKernels.erase(mapHeights.begin()->second);
+        mapHeights.erase(mapHeights.begin());
+    }
+    if (nHeight >= nMinHeight && mapKernels.emplace(kernel, Entry{hashBlock, nHeight}).second)
+        mapHeights.emplace(nHeight, kernel);
+}
+
+size_t CStakeSeen::Size() const
+{
+    LOCK(cs);
+    return mapKernels.size();
+}
+
+void InitSmartstakeCache()
+{
+    LOCK(cs_main);
+    cacheHit = 0;
+    cacheMiss = 0;
+    stakeModifiers.Rebuild(::ChainActive());
+    LogPrintf("%s : indexed stake modifiers for %d blocks\n", __func__, stakeModifiers.Size());
+}
+
+bool GetSmartstakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime)
+{
+    nStakeModifier = 0;
+
+    const CBlockIndex* pindexFrom = LookupBlockIndex(hashBlockFrom);
+    if (!pindexFrom)
+        return error("GetKernelStakeModifier() : block not indexed");
+
+    return stakeModifiers.Get(pindexFrom, nStakeModifier, nStakeModifierHeight, nStakeModifierTime);
+}
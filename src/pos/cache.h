@@ -5,15 +5,96 @@
 #ifndef SMARTSTAKE_CACHE_H
 #define SMARTSTAKE_CACHE_H
 
+#include <sync.h>
 #include <validation.h>
 
-#include <unordered_map>
+#include <atomic>
+#include <map>
+#include <vector>
 
+class CBlockIndex;
+class CChain;
 class uint256;
 
-const int FLUSH_POLICY = 45;
+/**
+ * Kernel stake modifiers of the active chain, indexed by the height of the
+ * block a stake comes from.
+ *
+ * The kernel modifier of block h is the modifier of the first later block
+ * that generated one at least a selection interval after h. Once that block
+ * is connected the value is final, so it is recorded together with the
+ * block that set it. Blocks still waiting for their modifier are kept by
+ * deadline and resolved as modifier-generating blocks are connected. A
+ * disconnect truncates the table at the old tip. Entries set by a
+ * disconnected block are noticed at lookup, because that block is no
+ * longer in the active chain, and are recomputed.
+ */
+class CStakeModifierIndex
+{
+private:
+    struct Entry {
+        uint64_t nStakeModifier{0};
+        //! Block whose generated modifier this is, null while unresolved
+        const CBlockIndex* pindexModifier{nullptr};
+    };
 
-extern std::unordered_map<unsigned int, uint64_t> cachedModifiers;
+    mutable Mutex cs;
+    std::vector<Entry> vEntries GUARDED_BY(cs);
+    //! Unresolved heights, by the block time their modifier must reach
+    std::multimap<int64_t, int> mapPending GUARDED_BY(cs);
+
+    void AddBlock(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    void BlockConnected(const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlockIndex* pindex);
+    /** Recompute the table from the active chain. */
+    void Rebuild(const CChain& chain);
+
+    /**
+     * Kernel modifier for stakes from pindexFrom, with the height and time
+     * of the block that generated it. Falls back to walking the chain for
+     * blocks outside the active chain or whose modifier is not final yet.
+     */
+    bool Get(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    size_t Size() const;
+};
+
+extern CStakeModifierIndex stakeModifiers;
+
+/**
+ * Kernels (staked output and block time) of the proof-of-stake blocks
+ * connected at recent heights. Another block with a kernel already seen restakes the
+ * same coin, which honest stakers never do. Kernels deeper than a
+ * reorganization may reach are forgotten, so memory stays bounded.
+ */
+class CStakeSeen
+{
+private:
+    typedef std::pair<COutPoint, unsigned int> Kernel;
+    struct Entry {
+        uint256 hashBlock;
+        int nHeight;
+    };
+
+    mutable Mutex cs;
+    std::map<Kernel, Entry> mapKernels GUARDED_BY(cs);
+    std::multimap<int, Kernel> mapHeights GUARDED_BY(cs);
+
+public:
+    /** Whether a block other than hashBlock already staked this kernel */
+    bool IsDuplicate(const Kernel& kernel, const uint256& hashBlock) const;
+    /** Record the kernel of a block at nHeight, forgetting those below nMinHeight */
+    void Add(const Kernel& kernel, const uint256& hashBlock, int nHeight, int nMinHeight);
+
+    size_t Size() const;
+};
+
+extern CStakeSeen stakeSeen;
+//! Modifier lookups answered by, and missed by, stakeModifiers since InitSmartstakeCache()
+extern std::atomic<uint64_t> cacheHit;
+extern std::atomic<uint64_t> cacheMiss;
 
 void InitSmartstakeCache();
 bool GetSmartstakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime);
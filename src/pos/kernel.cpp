@@ -8,6 +8,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <chainparams.h>
+#include <coins.h>
 #include <db.h>
 #include <init.h>
 #include <policy/policy.h>
@@ -272,10 +273,30 @@ bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTarget
     return UintToArith256(hashProofOfStake) < bnTarget;
 }
 
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransactionRef txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
+CStakeKernel::CStakeKernel(uint64_t nStakeModifier, unsigned int nTimeBlockFrom, const COutPoint& prevout, int64_t nValueIn, unsigned int nBits)
+    : prefix(SER_GETHASH, 0)
 {
-    int64_t nValueIn = txPrev->vout[prevout.n].nValue;
-    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
+    prefix << nStakeModifier << nTimeBlockFrom << prevout.n << prevout.hash;
+
+    arith_uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+    bnTarget = (arith_uint256(nValueIn) / 100) * bnTargetPerCoinDay;
+}
+
+uint256 CStakeKernel::GetHash(unsigned int nTimeTx) const
+{
+    CHashWriter ss(prefix);
+    ss << nTimeTx;
+    return ss.GetHash();
+}
+
+/**
+ * Check the age of a staked output created in pindexFrom against nTimeTx and
+ * look up the stake modifier its kernel is hashed with.
+ */
+static bool GetKernelStakeModifier(const CBlockIndex* pindexFrom, const COutPoint& prevout, unsigned int nTimeTx, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime)
+{
+    unsigned int nTimeBlockFrom = pindexFrom->GetBlockTime();
 
     if (nTimeTx < nTimeBlockFrom)
         return error("CheckStakeKernelHash() : nTime violation");
@@ -283,27 +304,33 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
     if (nTimeBlockFrom + Params().GetConsensus().nMinStakeAge > nTimeTx)
         return error("CheckStakeKernelHash() : min age violation - nTimeBlockFrom=%d nStakeMinAge=%d nTimeTx=%d", nTimeBlockFrom, 3600, nTimeTx);
 
-    arith_uint256 bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
-    uint64_t nStakeModifier = 0;
-    int nStakeModifierHeight = 0;
-    int64_t nStakeModifierTime = 0;
-
-    if (!GetSmartstakeModifier(blockFrom.GetHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime)) {
+    if (!stakeModifiers.Get(pindexFrom, nStakeModifier, nStakeModifierHeight, nStakeModifierTime)) {
         LogPrintf("CheckStakeKernelHash(): failed to get kernel stake modifier \n");
         return false;
     }
 
     if (gArgs.GetBoolArg("-printstakemodifier", false)) {
-        DebugStakeHash(nStakeModifier, blockFrom.nTime, prevout.n, prevout.hash, nTimeTx);
+        DebugStakeHash(nStakeModifier, nTimeBlockFrom, prevout.n, prevout.hash, nTimeTx);
     }
 
-    CDataStream ss(SER_GETHASH, 0);
-    ss << nStakeModifier;
+    return true;
+}
+
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, CAmount nValueIn, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
+{
+    unsigned int nTimeBlockFrom = pindexFrom->GetBlockTime();
+    uint64_t nStakeModifier = 0;
+    int nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime = 0;
+
+    if (!GetKernelStakeModifier(pindexFrom, prevout, nTimeTx, nStakeModifier, nStakeModifierHeight, nStakeModifierTime))
+        return false;
+
+    const CStakeKernel kernel(nStakeModifier, nTimeBlockFrom, prevout, nValueIn, nBits);
 
     if (fCheck) {
-        hashProofOfStake = stakeHash(nTimeTx, ss, prevout.n, prevout.hash, nTimeBlockFrom);
-        return stakeTargetHit(hashProofOfStake, nValueIn, ArithToUint256(bnTargetPerCoinDay));
+        hashProofOfStake = kernel.GetHash(nTimeTx);
+        return kernel.CheckHash(hashProofOfStake);
     }
 
     bool fSuccess = false;
@@ -315,9 +342,9 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
             break;
 
         nTryTime = nTimeTx + nHashDrift - i;
-        hashProofOfStake = stakeHash(nTryTime, ss, prevout.n, prevout.hash, nTimeBlockFrom);
+        hashProofOfStake = kernel.GetHash(nTryTime);
 
-        if (!stakeTargetHit(hashProofOfStake, nValueIn, ArithToUint256(bnTargetPerCoinDay)))
+        if (!kernel.CheckHash(hashProofOfStake))
             continue;
 
         fSuccess = true;
@@ -326,8 +353,8 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
         if (fPrintProofOfStake) {
             LogPrintf("CheckStakeKernelHash() : using modifier %s at height=%d timestamp=%s for block from height=%d timestamp=%d\n",
                 boost::lexical_cast<std::string>(nStakeModifier).c_str(), nStakeModifierHeight, nStakeModifierTime,
-                ::BlockIndex()[blockFrom.GetHash()]->nHeight,
-                blockFrom.GetBlockTime());
+                pindexFrom->nHeight,
+                pindexFrom->GetBlockTime());
             LogPrintf("CheckStakeKernelHash() : pass protocol=%s modifier=%s nTimeBlockFrom=%u prevoutHash=%s nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n",
                 "0.3",
                 boost::lexical_cast<std::string>(nStakeModifier).c_str(),
@@ -338,50 +365,53 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
         break;
     }
 
-    mapHashedBlocks.clear();
-    mapHashedBlocks[::ChainActive().Tip()->nHeight] = GetTime();
     return fSuccess;
 }
 
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
+std::shared_ptr<const CStakeKernel> GetProofOfStakeKernel(const CBlock& block, const CBlockIndex* pindexPrev, const CCoinsViewCache& view)
 {
     const CTransactionRef tx = block.vtx[1];
 
-    if (!tx->IsCoinStake())
-        return error("CheckProofOfStake() : called on non-coinstake %s", tx->GetHash().ToString());
+    if (!tx->IsCoinStake()) {
+        error("GetProofOfStakeKernel() : called on non-coinstake %s", tx->GetHash().ToString());
+        return nullptr;
+    }
 
     // Kernel (input 0) must match the stake hash target per coin age (nBits)
     const CTxIn& txin = tx->vin[0];
 
-    // Get transaction index for the previous transaction
-    CDiskTxPos postx;
-
-    if (!pblocktree->ReadTxIndex(txin.prevout.hash, postx))
-        return error("CheckProofOfStake() : tx index not found"); // tx index not found
+    // The staked output comes from the UTXO set and the block that created
+    // it from the block index, so no block file is read
+    const Coin& coin = view.AccessCoin(txin.prevout);
+    if (coin.IsSpent()) {
+        error("GetProofOfStakeKernel() : stake input %s missing or spent", txin.prevout.ToString());
+        return nullptr;
+    }
 
-    // Read txPrev and header of its block
-    CBlockHeader header;
-    CTransactionRef txPrev;
-    {
-        CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+    const CBlockIndex* pindexFrom = pindexPrev->GetAncestor(coin.nHeight);
+    if (!pindexFrom) {
+        error("GetProofOfStakeKernel() : block of stake input %s not found", txin.prevout.ToString());
+        return nullptr;
+    }
 
-        try {
-            file >> header;
-            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-            file >> txPrev;
-        } catch (std::exception& e) {
-            return error("%s() : deserialize or I/O error in CheckProofOfStake()", __PRETTY_FUNCTION__);
-        }
+    uint64_t nStakeModifier = 0;
+    int nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime = 0;
+    if (!GetKernelStakeModifier(pindexFrom, txin.prevout, block.nTime, nStakeModifier, nStakeModifierHeight, nStakeModifierTime))
+        return nullptr;
 
-        if (txPrev->GetHash() != txin.prevout.hash)
-            return error("%s() : txid mismatch in CheckProofOfStake()", __PRETTY_FUNCTION__);
-    }
+    return std::make_shared<const CStakeKernel>(nStakeModifier, pindexFrom->GetBlockTime(), txin.prevout, coin.out.nValue, block.nBits);
+}
 
-    unsigned int nInterval = 0;
-    unsigned int nTime = block.nTime;
+bool CheckProofOfStake(const CBlock& block, const CBlockIndex* pindexPrev, const CCoinsViewCache& view, uint256& hashProofOfStake)
+{
+    const std::shared_ptr<const CStakeKernel> kernel = GetProofOfStakeKernel(block, pindexPrev, view);
+    if (!kernel)
+        return false;
 
-    if (!CheckStakeKernelHash(block.nBits, header, txPrev, txin.prevout, nTime, nInterval, true, hashProofOfStake))
-        return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", tx->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str());
+    hashProofOfStake = kernel->GetHash(block.nTime);
+    if (!kernel->CheckHash(hashProofOfStake))
+        return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", block.vtx[1]->GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str());
 
     return true;
 }
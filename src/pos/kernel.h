@@ -1,9 +1,12 @@
 #ifndef BITCOIN_KERNEL_H
 #define BITCOIN_KERNEL_H
 
+#include <arith_uint256.h>
+#include <hash.h>
 #include <validation.h>
 
 class CBlockIndex;
+class CCoinsViewCache;
 class uint256;
 
 static const unsigned int MODIFIER_INTERVAL = 60;
@@ -14,7 +17,36 @@ int64_t GetStakeModifierSelectionInterval();
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransactionRef txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake);
+
+/**
+ * Kernel hash and target of one staked output, as computed by stakeHash()
+ * and stakeTargetHit(). The kernel prefix (modifier, nTimeBlockFrom,
+ * prevout) is serialized once and each candidate nTimeTx only appends four
+ * bytes to a copy of that hasher state; the value-weighted target is
+ * computed once instead of on every attempt.
+ */
+class CStakeKernel
+{
+public:
+    CStakeKernel(uint64_t nStakeModifier, unsigned int nTimeBlockFrom, const COutPoint& prevout, int64_t nValueIn, unsigned int nBits);
+
+    uint256 GetHash(unsigned int nTimeTx) const;
+    bool CheckHash(const uint256& hashProofOfStake) const { return UintToArith256(hashProofOfStake) < bnTarget; }
+    const arith_uint256& GetTarget() const { return bnTarget; }
+
+private:
+    CHashWriter prefix;
+    arith_uint256 bnTarget;
+};
+
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, CAmount nValueIn, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+/**
+ * Look up the kernel of a proof-of-stake block connecting on top of
+ * pindexPrev (staked output, modifier and target) without hashing it. This
+ * needs cs_main; the returned kernel can be checked on any thread.
+ */
+std::shared_ptr<const CStakeKernel> GetProofOfStakeKernel(const CBlock& block, const CBlockIndex* pindexPrev, const CCoinsViewCache& view);
+/** Check the kernel of a proof-of-stake block connecting on top of pindexPrev; the staked output is read from view. */
+bool CheckProofOfStake(const CBlock& block, const CBlockIndex* pindexPrev, const CCoinsViewCache& view, uint256& hashProofOfStake);
 
 #endif
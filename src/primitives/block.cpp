@@ -6,10 +6,117 @@
 
 #include <primitives/block.h>
 
+#include <crypto/siphash.h>
 #include <hash.h>
 #include <tinyformat.h>
 
+#include <algorithm>
+#include <random>
+
+#include <string.h>
+
+CHeaderHashMemo& CHeaderHashMemo::operator=(const CHeaderHashMemo& other)
+{
+    if (this == &other)
+        return *this;
+
+    std::unique_lock<std::mutex> lockThis(m_mutex, std::defer_lock);
+    std::unique_lock<std::mutex> lockOther(other.m_mutex, std::defer_lock);
+    std::lock(lockThis, lockOther);
+    m_valid = other.m_valid;
+    memcpy(m_header, other.m_header, sizeof(m_header));
+    m_hash = other.m_hash;
+    return *this;
+}
+
+bool CHeaderHashMemo::Get(const unsigned char* header, uint256& hash) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_valid || memcmp(m_header, header, sizeof(m_header)) != 0)
+        return false;
+    hash = m_hash;
+    return true;
+}
+
+void CHeaderHashMemo::Set(const unsigned char* header, const uint256& hash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    memcpy(m_header, header, sizeof(m_header));
+    m_hash = hash;
+    m_valid = true;
+}
+
+void CHeaderHashMemo::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_valid = false;
+}
+
+CHeaderHashCache::CHeaderHashCache(size_t nEntries) : m_entries(std::max<size_t>(nEntries, 1))
+{
+    std::random_device rd;
+    m_k0 = ((uint64_t)rd() << 32) | rd();
+    m_k1 = ((uint64_t)rd() << 32) | rd();
+}
+
+size_t CHeaderHashCache::Slot(const unsigned char* header) const
+{
+    return CSipHasher(m_k0, m_k1).Write(header, BLOCK_HEADER_SIZE).Finalize() % m_entries.size();
+}
+
+bool CHeaderHashCache::Get(const unsigned char* header, uint256& hash) const
+{
+    const size_t nSlot = Slot(header);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Entry& entry = m_entries[nSlot];
+    if (!entry.valid || memcmp(entry.header, header, BLOCK_HEADER_SIZE) != 0)
+        return false;
+    hash = entry.hash;
+    return true;
+}
+
+void CHeaderHashCache::Insert(const unsigned char* header, const uint256& hash)
+{
+    const size_t nSlot = Slot(header);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[nSlot];
+    memcpy(entry.header, header, BLOCK_HEADER_SIZE);
+    entry.hash = hash;
+    entry.valid = true;
+}
+
+void CHeaderHashCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Entry& entry : m_entries)
+        entry.valid = false;
+}
+
+CHeaderHashCache& HeaderHashCache()
+{
+    // Constructed on first use so that tools which never hash headers do not
+    // pay for the table.
+    static CHeaderHashCache cache(DEFAULT_HEADER_HASH_CACHE_ENTRIES);
+    return cache;
+}
+
 uint256 CBlockHeader::GetHash() const
+{
+    const unsigned char* header = (const unsigned char*)&nVersion;
+    uint256 hash;
+    if (hashMemo.Get(header, hash))
+        return hash;
+
+    CHeaderHashCache& cache = HeaderHashCache();
+    if (!cache.Get(header, hash)) {
+        hash = GetUncachedHash();
+        cache.Insert(header, hash);
+    }
+    hashMemo.Set(header, hash);
+    return hash;
+}
+
+uint256 CBlockHeader::GetUncachedHash() const
 {
     return argon2m_hash((char*)&(nVersion), (char*)&((&(nNonce))[1]));
 }
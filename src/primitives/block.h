@@ -10,6 +10,69 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <mutex>
+#include <vector>
+
+/** Number of serialized header bytes covered by the proof-of-work hash. */
+static const size_t BLOCK_HEADER_SIZE = 80;
+
+/** Memory-only memo of a header's proof-of-work hash. The hash is stored
+ * together with the header bytes it was computed from, so it is revalidated on
+ * every lookup and goes stale by itself when any header field is mutated.
+ */
+class CHeaderHashMemo
+{
+private:
+    mutable std::mutex m_mutex;
+    bool m_valid{false};
+    unsigned char m_header[BLOCK_HEADER_SIZE];
+    uint256 m_hash;
+
+public:
+    CHeaderHashMemo() {}
+    CHeaderHashMemo(const CHeaderHashMemo& other) { *this = other; }
+    CHeaderHashMemo& operator=(const CHeaderHashMemo& other);
+
+    bool Get(const unsigned char* header, uint256& hash) const;
+    void Set(const unsigned char* header, const uint256& hash);
+    void Clear();
+};
+
+/** Bounded, thread-safe cache from serialized block headers to their
+ * proof-of-work hash, shared by all CBlockHeader::GetHash() callers so that a
+ * header relayed by several peers, or revisited by validation, is only run
+ * through argon2m once. Entries live in a salted direct-mapped table; a
+ * colliding insert simply evicts the previous occupant.
+ */
+class CHeaderHashCache
+{
+private:
+    struct Entry {
+        bool valid{false};
+        unsigned char header[BLOCK_HEADER_SIZE];
+        uint256 hash;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+    uint64_t m_k0, m_k1;
+
+    size_t Slot(const unsigned char* header) const;
+
+public:
+    explicit CHeaderHashCache(size_t nEntries);
+
+    bool Get(const unsigned char* header, uint256& hash) const;
+    void Insert(const unsigned char* header, const uint256& hash);
+    void Clear();
+};
+
+/** Number of entries in the process-wide header hash cache (~3.7 MiB). */
+static const size_t DEFAULT_HEADER_HASH_CACHE_ENTRIES = 1 << 15;
+
+/** Process-wide header hash cache used by CBlockHeader::GetHash(). */
+CHeaderHashCache& HeaderHashCache();
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -29,6 +92,9 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    // memory only
+    mutable CHeaderHashMemo hashMemo;
+
     CBlockHeader()
     {
         SetNull();
@@ -54,6 +120,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        hashMemo.Clear();
     }
 
     bool IsNull() const
@@ -61,7 +128,10 @@ public:
         return (nBits == 0);
     }
 
+    /** Proof-of-work (argon2m) hash of the header. Memoized per object and
+     *  through HeaderHashCache(), see GetUncachedHash() for the raw path. */
     uint256 GetHash() const;
+    uint256 GetUncachedHash() const;
     uint256 GetLegacyHash() const;
 
     int64_t GetBlockTime() const
@@ -123,6 +193,7 @@ public:
         block.nTime          = nTime;
         block.nBits          = nBits;
         block.nNonce         = nNonce;
+        block.hashMemo       = hashMemo;
         return block;
     }
 
@@ -56,6 +56,7 @@ const char* FINALBUDGET = "fbs";
 const char* FINALBUDGETVOTE = "fbvote";
 const char* SYNCSTATUSCOUNT = "ssc";
 const char* DSEG = "dseg";
+const char* MNLISTDIGEST = "mnld";
 const char* DSEEP = "dseep";
 }; // namespace NetMsgType
 
@@ -118,6 +119,7 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::FINALBUDGETVOTE,
     NetMsgType::SYNCSTATUSCOUNT,
     NetMsgType::DSEG,
+    NetMsgType::MNLISTDIGEST,
     NetMsgType::FEEFILTER,
     NetMsgType::SENDCMPCT,
     NetMsgType::CMPCTBLOCK,
@@ -294,6 +294,11 @@ extern const char *FINALBUDGETVOTE;
  */
 extern const char *SYNCSTATUSCOUNT;
 extern const char *DSEG;
+/**
+ * The mnld message carries per-bucket hashes of the sender's masternode
+ * list; the peer replies with inventories for the buckets that differ
+ */
+extern const char *MNLISTDIGEST;
 extern const char *DSEEP;
 }; // namespace NetMsgType
 
@@ -72,6 +72,7 @@ UniValue listmasternodes(const JSONRPCRequest& request)
     }
 
     std::vector<std::pair<int, CMasternode>> vMasternodeRanks = mnodeman.GetMasternodeRanks(nHeight);
+    int nPaidDepth = mnodeman.CountEnabled() * 1.25;
     for (const auto& s : vMasternodeRanks) {
         UniValue obj(UniValue::VOBJ);
         std::string strVin = s.second.vin.prevout.ToStringShort();
@@ -98,7 +99,7 @@ UniValue listmasternodes(const JSONRPCRequest& request)
             obj.pushKV("ipaddr", mn->addr.ToString());
             obj.pushKV("lastseen", (int64_t)mn->lastPing.sigTime);
             obj.pushKV("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime));
-            obj.pushKV("lastpaid", (int64_t)mn->GetLastPaid());
+            obj.pushKV("lastpaid", (int64_t)mn->GetLastPaid(nPaidDepth));
 
             ret.push_back(obj);
         }
@@ -679,6 +680,57 @@ UniValue getmasternodescores(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getmasternodeverifyinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || (request.params.size() > 0))
+        throw std::runtime_error(
+            "getmasternodeverifyinfo\n"
+            "\nGet statistics on the verification of masternode messages\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"sigcache\": {       (object) Cache of valid mnb, mnp and spork signatures\n"
+            "    \"capacity\": n,    (numeric) Number of signatures the cache can hold\n"
+            "    \"hits\": n,        (numeric) Signatures found in the cache\n"
+            "    \"misses\": n       (numeric) Signatures that had to be recovered\n"
+            "  },\n"
+            "  \"queue\": {          (object) Received mnb and mnp messages verified off the net thread\n"
+            "    \"depth\": n,       (numeric) Messages waiting for verification\n"
+            "    \"processed\": n,   (numeric) Messages verified\n"
+            "    \"dropped\": n,     (numeric) Messages dropped because the queue was full\n"
+            "    \"batches\": n,     (numeric) Batches verified under one cs_main lock\n"
+            "    \"avglatency\": n,  (numeric) Average time from receipt to verification, in microseconds\n"
+            "    \"maxlatency\": n   (numeric) Longest time from receipt to verification, in microseconds\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("getmasternodeverifyinfo", "") + HelpExampleRpc("getmasternodeverifyinfo", ""));
+
+    const CMasternodeSigCacheStats stats = GetMasternodeSigCacheStats();
+
+    UniValue sigcache(UniValue::VOBJ);
+    sigcache.pushKV("capacity", (int64_t)stats.nCapacity);
+    sigcache.pushKV("hits", (int64_t)stats.nHits);
+    sigcache.pushKV("misses", (int64_t)stats.nMisses);
+
+    const CMasternodeVerifyStats queueStats = mnodeman.GetVerifyStats();
+
+    UniValue queue(UniValue::VOBJ);
+    queue.pushKV("depth", (int64_t)queueStats.nQueued);
+    queue.pushKV("processed", (int64_t)queueStats.nProcessed);
+    queue.pushKV("dropped", (int64_t)queueStats.nDropped);
+    queue.pushKV("batches", (int64_t)queueStats.nBatches);
+    queue.pushKV("avglatency", queueStats.nAvgLatency);
+    queue.pushKV("maxlatency", queueStats.nMaxLatency);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("sigcache", sigcache);
+    obj.pushKV("queue", queue);
+
+    return obj;
+}
+
 bool DecodeHexMnb(CMasternodeBroadcast& mnb, std::string strHexMnb)
 {
 
@@ -876,6 +928,7 @@ void RegisterMasternodeCommands(CRPCTable &t)
           {"masternode",        "getmasternodestatus",       &getmasternodestatus,       {}},
           {"masternode",        "getmasternodewinners",      &getmasternodewinners,      {}},
           {"masternode",        "getmasternodescores",       &getmasternodescores,       {}},
+          {"masternode",        "getmasternodeverifyinfo",   &getmasternodeverifyinfo,   {}},
     };
 
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
@@ -123,14 +123,22 @@ static UniValue generateBlocks(const CTxMemPool& mempool, const CScript& coinbas
             LOCK(cs_main);
             IncrementExtraNonce(pblock, ::ChainActive().Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < std::numeric_limits<uint32_t>::max() && !CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus()) && !ShutdownRequested()) {
-            ++pblock->nNonce;
-            --nMaxTries;
+        const arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
+        CPoWSearch search(*pblock);
+        uint256 hash;
+        bool fFound = false;
+        while (nMaxTries > 0 && pblock->nNonce < std::numeric_limits<uint32_t>::max() && !ShutdownRequested()) {
+            const uint32_t nCount = std::min<uint64_t>(std::min<uint64_t>(nMaxTries, std::numeric_limits<uint32_t>::max() - pblock->nNonce), MINER_SCAN_BATCH);
+            uint32_t nNonce = pblock->nNonce;
+            fFound = search.Scan(nNonce, nCount, hashTarget, hash);
+            nMaxTries -= nNonce - pblock->nNonce;
+            pblock->nNonce = nNonce;
+            if (fFound) break;
         }
-        if (nMaxTries == 0 || ShutdownRequested()) {
+        if (!fFound && (nMaxTries == 0 || ShutdownRequested())) {
             break;
         }
-        if (pblock->nNonce == std::numeric_limits<uint32_t>::max()) {
+        if (!fFound) {
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -245,6 +253,16 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
                         {RPCResult::Type::NUM, "pooledtx", "The size of the mempool"},
                         {RPCResult::Type::STR, "chain", "current network name (main, test, regtest)"},
                         {RPCResult::Type::STR, "warnings", "any network and blockchain warnings"},
+                        {RPCResult::Type::NUM, "hashespersec", "The combined hash rate of the local proof-of-work threads"},
+                        {RPCResult::Type::ARR, "threads", "The local proof-of-work threads (empty unless -gen is set)",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::NUM, "thread", "The thread index"},
+                                {RPCResult::Type::NUM, "hashes", "The number of hashes computed by this thread"},
+                                {RPCResult::Type::NUM, "hashespersec", "The recent hash rate of this thread"},
+                            }},
+                        }},
                     }},
                 RPCExamples{
                     HelpExampleCli("getmininginfo", "")
@@ -264,6 +282,19 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
     obj.pushKV("chain",            Params().NetworkIDString());
     obj.pushKV("warnings",         GetWarnings(false));
+
+    double dHashesPerSec = 0;
+    UniValue threads(UniValue::VARR);
+    for (const MinerThreadInfo& info : GetMinerThreadInfo()) {
+        UniValue thread(UniValue::VOBJ);
+        thread.pushKV("thread", info.nThread);
+        thread.pushKV("hashes", info.nHashes);
+        thread.pushKV("hashespersec", info.dHashesPerSec);
+        threads.push_back(thread);
+        dHashesPerSec += info.dHashesPerSec;
+    }
+    obj.pushKV("hashespersec",     dHashesPerSec);
+    obj.pushKV("threads",          threads);
     return obj;
 }
 
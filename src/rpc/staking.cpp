@@ -4,8 +4,10 @@
 
 #include <chainparams.h>
 #include <consensus/params.h>
+#include <core_io.h>
 #include <miner.h>
 #include <node/context.h>
+#include <pos/cache.h>
 #include <pos/kernel.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
@@ -121,6 +123,96 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
     return obj;
 }
 
+static UniValue HistogramToJSON(const std::array<uint64_t, STAKING_STATS_BUCKETS>& vBuckets)
+{
+    UniValue histogram(UniValue::VOBJ);
+    for (int i = 0; i < STAKING_STATS_BUCKETS; ++i)
+        histogram.pushKV(i < STAKING_STATS_BUCKETS - 1 ? strprintf("<%d", 1 << i) : strprintf(">=%d", 1 << (i - 1)), vBuckets[i]);
+    return histogram;
+}
+
+UniValue getstakingstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getstakingstats ( histograms )\n"
+            "Returns statistics of the staking kernel searches since startup and of the latest one.\n"
+            "\nArguments:\n"
+            "1. histograms          (boolean, optional, default=false) also return histograms of search and lock times\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"searches\": n,             (numeric) kernel searches run\n"
+            "  \"found\": n,                (numeric) searches that found a kernel\n"
+            "  \"cancelled\": n,            (numeric) searches cancelled by a new tip\n"
+            "  \"hashes\": n,               (numeric) kernel hashes evaluated\n"
+            "  \"hashespersec\": x.x,       (numeric) kernel hashes per second of search time\n"
+            "  \"searchms\": x.x,           (numeric) average search time in milliseconds\n"
+            "  \"lockms\": x.x,             (numeric) average time cs_main and the wallet were held per search\n"
+            "  \"modifiercache\": {         (json object) stake modifier lookups\n"
+            "    \"hits\": n,\n"
+            "    \"misses\": n,\n"
+            "    \"hitrate\": x.x\n"
+            "  },\n"
+            "  \"last\": {                  (json object) the latest search\n"
+            "    \"time\": n,               (numeric) first kernel timestamp it covered\n"
+            "    \"coins\": n,              (numeric) coins scanned\n"
+            "    \"value\": x.x,            (numeric) value of the coins scanned\n"
+            "    \"hashes\": n,             (numeric) kernel hashes evaluated\n"
+            "    \"hashespersec\": x.x,     (numeric) kernel hashes per second\n"
+            "    \"searchms\": x.x,         (numeric) search time in milliseconds\n"
+            "    \"lockms\": x.x,           (numeric) time cs_main and the wallet were held\n"
+            "    \"bestdistance\": x.x,     (numeric) best hash over its coin's target, a kernel needs less than 1\n"
+            "    \"expectedtime\": x.x      (numeric) expected seconds to a kernel at this target with these coins\n"
+            "  },\n"
+            "  \"histograms\": {            (json object, only with histograms) search and lock times,\n"
+            "    \"searchms\": {...},       counted in power of two millisecond buckets\n"
+            "    \"lockms\": {...}\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getstakingstats", "") + HelpExampleCli("getstakingstats", "true") + HelpExampleRpc("getstakingstats", "true"));
+
+    const CStakingStats stats = stake.GetStakingStats();
+    const uint64_t nCacheHits = cacheHit;
+    const uint64_t nCacheMisses = cacheMiss;
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("searches", stats.nSearches);
+    obj.pushKV("found", stats.nFound);
+    obj.pushKV("cancelled", stats.nCancelled);
+    obj.pushKV("hashes", stats.nHashes);
+    obj.pushKV("hashespersec", stats.nSearchMicros > 0 ? stats.nHashes * 1e6 / stats.nSearchMicros : 0.0);
+    obj.pushKV("searchms", stats.nSearches > 0 ? stats.nSearchMicros * 0.001 / stats.nSearches : 0.0);
+    obj.pushKV("lockms", stats.nSearches > 0 ? stats.nLockMicros * 0.001 / stats.nSearches : 0.0);
+
+    UniValue cache(UniValue::VOBJ);
+    cache.pushKV("hits", nCacheHits);
+    cache.pushKV("misses", nCacheMisses);
+    cache.pushKV("hitrate", nCacheHits + nCacheMisses > 0 ? (double)nCacheHits / (nCacheHits + nCacheMisses) : 0.0);
+    obj.pushKV("modifiercache", cache);
+
+    UniValue last(UniValue::VOBJ);
+    last.pushKV("time", stats.nLastTime);
+    last.pushKV("coins", stats.nLastCoins);
+    last.pushKV("value", ValueFromAmount(stats.nLastValue));
+    last.pushKV("hashes", stats.nLastHashes);
+    last.pushKV("hashespersec", stats.nLastSearchMicros > 0 ? stats.nLastHashes * 1e6 / stats.nLastSearchMicros : 0.0);
+    last.pushKV("searchms", stats.nLastSearchMicros * 0.001);
+    last.pushKV("lockms", stats.nLastLockMicros * 0.001);
+    last.pushKV("bestdistance", stats.dLastBestDistance);
+    last.pushKV("expectedtime", stats.dLastExpectedTime);
+    obj.pushKV("last", last);
+
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        UniValue histograms(UniValue::VOBJ);
+        histograms.pushKV("searchms", HistogramToJSON(stats.vSearchMillis));
+        histograms.pushKV("lockms", HistogramToJSON(stats.vLockMillis));
+        obj.pushKV("histograms", histograms);
+    }
+
+    return obj;
+}
+
 void RegisterStakingRPCCommands(CRPCTable &t)
 {
 // clang-format off
@@ -130,6 +222,7 @@ static const CRPCCommand commands[] =
     { "staking",            "getstakingset",          &getstakingset,          {} },
     { "staking",            "getbestproofhash",       &getbestproofhash,       {} },
     { "staking",            "getstakingstatus",       &getstakingstatus,       {} },
+    { "staking",            "getstakingstats",        &getstakingstats,        {"histograms"} },
 };
 // clang-format on
 
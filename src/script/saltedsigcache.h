@@ -0,0 +1,72 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SCRIPT_SALTEDSIGCACHE_H
+#define BITCOIN_SCRIPT_SALTEDSIGCACHE_H
+
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <pubkey.h>
+#include <random.h>
+#include <script/sigcache.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <vector>
+
+#include <boost/thread/shared_mutex.hpp>
+
+/**
+ * Cache of valid signatures checked outside of scripts, such as block and
+ * masternode message signatures. With fCountLookups, hits and misses are
+ * counted for reporting.
+ */
+template <bool fCountLookups = false>
+class CSaltedSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || signed hash || public key || signature):
+    uint256 nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> setValid;
+    boost::shared_mutex cs_sigcache;
+    uint32_t nElements;
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
+public:
+    explicit CSaltedSignatureCache(size_t nBytes)
+    {
+        GetRandBytes(nonce.begin(), 32);
+        nElements = setValid.setup_bytes(nBytes);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry, const bool erase)
+    {
+        bool fFound;
+        {
+            boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+            fFound = setValid.contains(entry, erase);
+        }
+        if (fCountLookups)
+            ++(fFound ? nHits : nMisses);
+        return fFound;
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t Capacity() const { return nElements; }
+    uint64_t Hits() const { return nHits; }
+    uint64_t Misses() const { return nMisses; }
+};
+
+#endif // BITCOIN_SCRIPT_SALTEDSIGCACHE_H
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <crypto/aes.h>
+#include <crypto/argon2m.h>
 #include <crypto/chacha20.h>
 #include <crypto/chacha_poly_aead.h>
 #include <crypto/poly1305.h>
@@ -750,4 +751,19 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(argon2m)
+{
+    // The specialized kernel must agree with the generic Argon2 code.
+    for (int i = 0; i < 32; ++i) {
+        unsigned char in[ARGON2M_INPUT_SIZE];
+        unsigned char out1[ARGON2M_OUTPUT_SIZE], out2[ARGON2M_OUTPUT_SIZE];
+        for (size_t j = 0; j < sizeof(in); ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        Argon2mReferenceHash(in, out1);
+        Argon2mHash(in, out2);
+        BOOST_CHECK(memcmp(out1, out2, sizeof(out1)) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
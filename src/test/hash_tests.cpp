@@ -5,6 +5,7 @@
 #include <clientversion.h>
 #include <crypto/siphash.h>
 #include <hash.h>
+#include <primitives/block.h>
 #include <util/strencodings.h>
 #include <test/util/setup_common.h>
 
@@ -147,4 +148,43 @@ BOOST_AUTO_TEST_CASE(siphash)
     }
 }
 
+BOOST_AUTO_TEST_CASE(header_hash_memo)
+{
+    CBlockHeader header;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = InsecureRand32();
+    header.nBits = 0x1e0fffff;
+    header.nNonce = 1;
+
+    // Memoized and cached results match the raw argon2m hash.
+    const uint256 hash = header.GetUncachedHash();
+    BOOST_CHECK(header.GetHash() == hash);
+    BOOST_CHECK(header.GetHash() == hash);
+    CBlockHeader copy = header;
+    copy.hashMemo.Clear();
+    BOOST_CHECK(copy.GetHash() == hash);
+
+    // Mutating a field invalidates the memo.
+    header.nNonce++;
+    BOOST_CHECK(header.GetHash() == header.GetUncachedHash());
+    BOOST_CHECK(header.GetHash() != hash);
+
+    // A copy made from a stale memo still hashes its own bytes.
+    CBlock block(header);
+    block.nNonce--;
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+
+    // Nothing is served from a cleared cache.
+    HeaderHashCache().Clear();
+    CBlockHeader fresh = header;
+    fresh.hashMemo.Clear();
+    uint256 cached;
+    BOOST_CHECK(!HeaderHashCache().Get((const unsigned char*)&fresh.nVersion, cached));
+    BOOST_CHECK(fresh.GetHash() == header.GetUncachedHash());
+    BOOST_CHECK(HeaderHashCache().Get((const unsigned char*)&fresh.nVersion, cached));
+    BOOST_CHECK(cached == fresh.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,223 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <key.h>
+#include <masternode/masternode-payments.h>
+#include <masternode/masternode.h>
+#include <script/standard.h>
+#include <test/util/masternode.h>
+#include <test/util/setup_common.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+// Load enough votes for payee at nBlockHeight to count it as paid
+void LoadPaidVotes(CMasternodePayments& payments, const CScript& payee, int nBlockHeight)
+{
+    for (int i = 0; i < MNPAYMENTS_PAID_VOTES; ++i)
+        payments.LoadVote(MakeVote(nBlockHeight, payee));
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(masternode_payments_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(last_paid_height)
+{
+    CMasternodePayments payments;
+    const CScript payee = RandomPayee();
+
+    // never paid
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 100, 10), -1);
+
+    // a single vote does not count as a payment
+    payments.LoadVote(MakeVote(95, payee));
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 100, 10), -1);
+
+    payments.LoadVote(MakeVote(95, payee));
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 100, 10), 95);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 100, 6), 95);
+    // depth N only looks at (tip - N, tip]
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 100, 5), -1);
+    // heights above the tip are not paid yet
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 94, 10), -1);
+
+    // the latest payment wins
+    LoadPaidVotes(payments, payee, 98);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 100, 10), 98);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, 97, 10), 95);
+
+    // other payees are not affected
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(RandomPayee(), 100, 10), -1);
+}
+
+BOOST_AUTO_TEST_CASE(block_ring_growth)
+{
+    CMasternodePayments payments;
+    const CScript payee1 = RandomPayee();
+    const CScript payee2 = RandomPayee();
+
+    // two heights in the same slot of the initial ring
+    payments.LoadVote(MakeVote(100, payee1));
+    payments.LoadVote(MakeVote(100 + MNPAYMENTS_BLOCK_RING_SIZE, payee2));
+
+    CScript payee;
+    BOOST_CHECK(payments.GetBlockPayee(100, payee));
+    BOOST_CHECK(payee == payee1);
+    BOOST_CHECK(payments.GetBlockPayee(100 + MNPAYMENTS_BLOCK_RING_SIZE, payee));
+    BOOST_CHECK(payee == payee2);
+    BOOST_CHECK(!payments.GetBlockPayee(100 + 2 * MNPAYMENTS_BLOCK_RING_SIZE, payee));
+    BOOST_CHECK_EQUAL(payments.GetOldestBlock(), 100);
+    BOOST_CHECK_EQUAL(payments.GetNewestBlock(), 100 + MNPAYMENTS_BLOCK_RING_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(block_ring_lookups_after_growth)
+{
+    CMasternodePayments payments;
+    std::map<int, CScript> mapPayees;
+
+    // enough consecutive heights to grow the ring twice
+    const int nHeights = 3 * MNPAYMENTS_BLOCK_RING_SIZE;
+    for (int nHeight = 1; nHeight <= nHeights; ++nHeight) {
+        mapPayees[nHeight] = RandomPayee();
+        payments.LoadVote(MakeVote(nHeight, mapPayees[nHeight]));
+    }
+
+    // a second vote for one of the payees only adds to the existing block
+    payments.LoadVote(MakeVote(7, mapPayees[7]));
+
+    bool fAllFound = true;
+    for (const auto& entry : mapPayees) {
+        CScript payee;
+        fAllFound &= payments.GetBlockPayee(entry.first, payee) && payee == entry.second;
+    }
+    BOOST_CHECK(fAllFound);
+
+    CScript payee;
+    BOOST_CHECK(!payments.GetBlockPayee(0, payee));
+    BOOST_CHECK(!payments.GetBlockPayee(nHeights + 1, payee));
+    BOOST_CHECK_EQUAL(payments.GetOldestBlock(), 1);
+    BOOST_CHECK_EQUAL(payments.GetNewestBlock(), nHeights);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(mapPayees[7], nHeights, nHeights), 7);
+}
+
+BOOST_AUTO_TEST_CASE(block_ring_erase_reinsert)
+{
+    CMasternodePayments payments;
+    const CScript payee1 = RandomPayee();
+    const CScript payee2 = RandomPayee();
+    const CMasternodePaymentWinner vote = MakeVote(100, payee1);
+
+    payments.LoadVote(vote);
+    payments.LoadVote(MakeVote(100 + MNPAYMENTS_BLOCK_RING_SIZE, payee2));
+
+    // drop height 100, which shares its slot with the kept height
+    payments.CleanPaymentList(100 + MNPAYMENTS_BLOCK_RING_SIZE, MNPAYMENTS_BLOCK_RING_SIZE - 1);
+    CScript payee;
+    BOOST_CHECK(!payments.HasVote(vote.GetHash()));
+    BOOST_CHECK(!payments.GetBlockPayee(100, payee));
+    BOOST_CHECK(payments.GetBlockPayee(100 + MNPAYMENTS_BLOCK_RING_SIZE, payee));
+    BOOST_CHECK(payee == payee2);
+
+    // the erased height can be filled again
+    payments.LoadVote(vote);
+    BOOST_CHECK(payments.HasVote(vote.GetHash()));
+    BOOST_CHECK(payments.GetBlockPayee(100, payee));
+    BOOST_CHECK(payee == payee1);
+    BOOST_CHECK(payments.GetBlockPayee(100 + MNPAYMENTS_BLOCK_RING_SIZE, payee));
+    BOOST_CHECK(payee == payee2);
+}
+
+BOOST_AUTO_TEST_CASE(block_ring_last_paid_height)
+{
+    CMasternodePayments payments;
+    const CScript payee = RandomPayee();
+
+    // paid at heights that all map to the same slot of the initial ring
+    const int nHeight1 = 100;
+    const int nHeight2 = nHeight1 + MNPAYMENTS_BLOCK_RING_SIZE;
+    const int nHeight3 = nHeight1 + 2 * MNPAYMENTS_BLOCK_RING_SIZE;
+    LoadPaidVotes(payments, payee, nHeight1);
+    LoadPaidVotes(payments, payee, nHeight2);
+    LoadPaidVotes(payments, payee, nHeight3);
+
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, nHeight3 + 10, nHeight3), nHeight3);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, nHeight3 - 1, nHeight3), nHeight2);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, nHeight2 - 1, nHeight3), nHeight1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, nHeight3 - 1, MNPAYMENTS_BLOCK_RING_SIZE - 1), -1);
+
+    // a paid height is forgotten with its block
+    payments.CleanPaymentList(nHeight3, MNPAYMENTS_BLOCK_RING_SIZE);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, nHeight2 - 1, nHeight3), -1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payee, nHeight3 - 1, nHeight3), nHeight2);
+}
+
+BOOST_AUTO_TEST_CASE(clean_payment_list)
+{
+    CMasternodePayments payments;
+    std::vector<CMasternodePaymentWinner> vVotes;
+    for (int nHeight = 1; nHeight <= 20; ++nHeight) {
+        vVotes.push_back(MakeVote(nHeight, RandomPayee()));
+        payments.LoadVote(vVotes.back());
+    }
+
+    // nothing is older than the limit
+    payments.CleanPaymentList(20, 20);
+    BOOST_CHECK_EQUAL(payments.GetOldestBlock(), 1);
+
+    // keeps heights at most nLimit below nHeight
+    payments.CleanPaymentList(25, 10);
+    for (const CMasternodePaymentWinner& vote : vVotes) {
+        CScript payee;
+        const bool fKept = vote.nBlockHeight >= 15;
+        BOOST_CHECK_EQUAL(payments.HasVote(vote.GetHash()), fKept);
+        BOOST_CHECK_EQUAL(payments.GetBlockPayee(vote.nBlockHeight, payee), fKept);
+    }
+    BOOST_CHECK_EQUAL(payments.GetOldestBlock(), 15);
+    BOOST_CHECK_EQUAL(payments.GetNewestBlock(), 20);
+
+    // the removed votes are flushed as erasures
+    std::vector<CMasternodePaymentWinner> vAdded;
+    std::vector<uint256> vRemoved;
+    payments.GetChanges(vAdded, vRemoved);
+    BOOST_CHECK(vAdded.empty());
+    BOOST_CHECK_EQUAL(vRemoved.size(), 14U);
+}
+
+BOOST_FIXTURE_TEST_CASE(last_paid_time, TestChain100Setup)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(InsecureRand256(), 0));
+    mn.pubKeyCollateralAddress = key.GetPubKey();
+    const CScript payee = GetScriptForDestination(PKHash(mn.pubKeyCollateralAddress));
+
+    int nTipHeight;
+    int64_t nPaidTime;
+    {
+        LOCK(cs_main);
+        nTipHeight = ::ChainActive().Height();
+        nPaidTime = ::ChainActive()[nTipHeight - 5]->GetBlockTime();
+    }
+
+    // never paid
+    BOOST_CHECK_EQUAL(mn.GetLastPaid(10), 0);
+
+    // paid 5 blocks below the tip: the block time plus an offset of less than 150 seconds
+    LoadPaidVotes(masternodePayments, payee, nTipHeight - 5);
+    const int64_t nLastPaid = mn.GetLastPaid(10);
+    BOOST_CHECK(nLastPaid >= nPaidTime);
+    BOOST_CHECK(nLastPaid < nPaidTime + 150);
+    BOOST_CHECK_EQUAL(mn.GetLastPaid(6), nLastPaid);
+
+    // outside the searched depth
+    BOOST_CHECK_EQUAL(mn.GetLastPaid(5), 0);
+
+    masternodePayments.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
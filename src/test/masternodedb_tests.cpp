@@ -0,0 +1,171 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <masternode/masternode-payments.h>
+#include <masternode/masternode.h>
+#include <masternode/masternodedb.h>
+#include <masternode/masternodeman.h>
+#include <streams.h>
+#include <test/util/masternode.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+void CheckMasternodes(CMasternodeMan& mnman, const std::vector<CMasternode>& vMasternodes)
+{
+    BOOST_CHECK_EQUAL(mnman.size(), (int)vMasternodes.size());
+    for (const CMasternode& mn : vMasternodes) {
+        const CMasternode* pmn = mnman.Find(mn.vin);
+        BOOST_REQUIRE(pmn != nullptr);
+        BOOST_CHECK(pmn->pubKeyCollateralAddress == mn.pubKeyCollateralAddress);
+        BOOST_CHECK(pmn->pubKeyMasternode == mn.pubKeyMasternode);
+        BOOST_CHECK_EQUAL(pmn->sigTime, mn.sigTime);
+        BOOST_CHECK(pmn->lastPing == mn.lastPing);
+    }
+}
+
+void CheckVotes(CMasternodePayments& payments, const std::vector<CMasternodePaymentWinner>& vVotes)
+{
+    for (const CMasternodePaymentWinner& vote : vVotes) {
+        CMasternodePaymentWinner winner;
+        BOOST_REQUIRE(payments.GetVote(vote.GetHash(), winner));
+        BOOST_CHECK_EQUAL(winner.nBlockHeight, vote.nBlockHeight);
+        BOOST_CHECK(winner.payee == vote.payee);
+    }
+}
+
+/** Write obj in the layout of the old mncache.dat and mnpayments.dat */
+template <typename T>
+void WriteFlatFile(const std::string& strFilename, const std::string& strMagicMessage, const T& obj)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << strMagicMessage;
+    ss << MakeSpan(Params().MessageStart());
+    ss << obj;
+    uint256 hash = Hash(ss.begin(), ss.end());
+    ss << hash;
+
+    CAutoFile fileout(fsbridge::fopen(GetDataDir() / strFilename, "wb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!fileout.IsNull());
+    fileout << ss;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(masternodedb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(store_round_trip)
+{
+    std::vector<CMasternode> vMasternodes{MakeMasternode(), MakeMasternode(), MakeMasternode()};
+    std::vector<CMasternodePaymentWinner> vVotes{MakeVote(10), MakeVote(10), MakeVote(11)};
+
+    std::unique_ptr<CMasternodeStore> store(new CMasternodeStore(1 << 20, false, true));
+    BOOST_CHECK(store->WriteChanges(vMasternodes, {}, vVotes, {}));
+    // removals are written as erasures
+    BOOST_CHECK(store->WriteChanges({}, {vMasternodes.back().vin.prevout}, {}, {vVotes.back().GetHash()}));
+    const CMasternode mnRemoved = vMasternodes.back();
+    const CMasternodePaymentWinner voteRemoved = vVotes.back();
+    vMasternodes.pop_back();
+    vVotes.pop_back();
+    store.reset();
+
+    store.reset(new CMasternodeStore(1 << 20));
+    CMasternodeMan mnman;
+    CMasternodePayments payments;
+    BOOST_CHECK(store->LoadMasternodes(mnman));
+    BOOST_CHECK(store->LoadPaymentVotes(payments));
+
+    CheckMasternodes(mnman, vMasternodes);
+    BOOST_CHECK(mnman.Find(mnRemoved.vin) == nullptr);
+    CheckVotes(payments, vVotes);
+    BOOST_CHECK(!payments.HasVote(voteRemoved.GetHash()));
+
+    // loaded entries are not written back
+    std::vector<CMasternode> vChanged;
+    std::vector<COutPoint> vRemoved;
+    mnman.GetChanges(vChanged, vRemoved);
+    BOOST_CHECK(vChanged.empty() && vRemoved.empty());
+}
+
+BOOST_AUTO_TEST_CASE(changes_marked_dirty)
+{
+    CMasternodeMan mnman;
+    CMasternode mn = MakeMasternode();
+    BOOST_REQUIRE(mnman.Add(mn));
+
+    CMasternodePayments payments;
+    const CMasternodePaymentWinner vote = MakeVote(10);
+    payments.LoadVote(vote);
+    payments.MarkDirty({vote}, {});
+
+    // what a failed flush took is handed out again by the next GetChanges
+    std::vector<CMasternode> vChanged;
+    std::vector<COutPoint> vRemoved;
+    mnman.GetChanges(vChanged, vRemoved);
+    BOOST_REQUIRE_EQUAL(vChanged.size(), 1U);
+    const COutPoint outpointRemoved(InsecureRand256(), 0);
+    mnman.MarkDirty(vChanged, {outpointRemoved});
+    vChanged.clear();
+    mnman.GetChanges(vChanged, vRemoved);
+    BOOST_CHECK_EQUAL(vChanged.size(), 1U);
+    BOOST_CHECK(vChanged[0].vin == mn.vin);
+    BOOST_REQUIRE_EQUAL(vRemoved.size(), 1U);
+    BOOST_CHECK(vRemoved[0] == outpointRemoved);
+
+    std::vector<CMasternodePaymentWinner> vAdded;
+    std::vector<uint256> vVotesRemoved;
+    payments.GetChanges(vAdded, vVotesRemoved);
+    BOOST_REQUIRE_EQUAL(vAdded.size(), 1U);
+    BOOST_CHECK(vAdded[0].GetHash() == vote.GetHash());
+    BOOST_CHECK(vVotesRemoved.empty());
+}
+
+BOOST_AUTO_TEST_CASE(import_flat_files)
+{
+    std::vector<CMasternode> vMasternodes{MakeMasternode(), MakeMasternode()};
+    std::vector<CMasternodePaymentWinner> vVotes{MakeVote(10), MakeVote(11)};
+
+    {
+        CMasternodeMan mnman;
+        for (CMasternode& mn : vMasternodes)
+            BOOST_REQUIRE(mnman.Add(mn));
+        WriteFlatFile("mncache.dat", "MasternodeCache", mnman);
+
+        std::map<uint256, CMasternodePaymentWinner> mapVotes;
+        for (const CMasternodePaymentWinner& vote : vVotes)
+            mapVotes.emplace(vote.GetHash(), vote);
+        WriteFlatFile("mnpayments.dat", "MasternodePayments", std::make_pair(mapVotes, std::map<int, CMasternodeBlockPayees>()));
+    }
+
+    // the first start imports the flat files and drops them
+    BOOST_REQUIRE(LoadMasternodeStore());
+    CheckMasternodes(mnodeman, vMasternodes);
+    CheckVotes(masternodePayments, vVotes);
+    BOOST_CHECK(!fs::exists(GetDataDir() / "mncache.dat"));
+    BOOST_CHECK(!fs::exists(GetDataDir() / "mnpayments.dat"));
+
+    // the next one reads the masternode store
+    pmasternodestore.reset();
+    mnodeman.Clear();
+    masternodePayments.Clear();
+    BOOST_REQUIRE(LoadMasternodeStore());
+    CheckMasternodes(mnodeman, vMasternodes);
+    CheckVotes(masternodePayments, vVotes);
+
+    pmasternodestore.reset();
+    mnodeman.Clear();
+    masternodePayments.Clear();
+    std::vector<CMasternode> vChanged;
+    std::vector<COutPoint> vRemoved;
+    mnodeman.GetChanges(vChanged, vRemoved);
+    std::vector<CMasternodePaymentWinner> vVotesAdded;
+    std::vector<uint256> vVotesRemoved;
+    masternodePayments.GetChanges(vVotesAdded, vVotesRemoved);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,63 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <masternode/masternode.h>
+#include <masternode/masternodeman.h>
+#include <net.h>
+#include <test/util/masternode.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+std::set<uint256> GetAnnounced(CNode& node)
+{
+    std::set<uint256> setHashes;
+    for (const CInv& inv : node.vInventoryOtherToSend) {
+        BOOST_CHECK_EQUAL(inv.type, MSG_MASTERNODE_ANNOUNCE);
+        setHashes.insert(inv.hash);
+    }
+    node.vInventoryOtherToSend.clear();
+    return setHashes;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(list_digest_diff)
+{
+    CMasternodeMan mnman;
+    std::vector<CMasternode> vMasternodes{MakeMasternode(1), MakeMasternode(1), MakeMasternode(2)};
+    for (CMasternode& mn : vMasternodes)
+        BOOST_REQUIRE(mnman.Add(mn));
+
+    std::vector<uint256> vDigest;
+    mnman.GetListDigest(vDigest);
+    BOOST_CHECK_EQUAL(vDigest.size(), MASTERNODES_DIGEST_BUCKETS);
+    BOOST_CHECK(!vDigest[1].IsNull());
+    BOOST_CHECK(!vDigest[2].IsNull());
+    BOOST_CHECK(vDigest[3].IsNull());
+
+    CAddress addr(CService(CNetAddr(), 0), NODE_NONE);
+    CNode node(0, ServiceFlags(NODE_NETWORK), 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+
+    // an identical digest sends nothing
+    BOOST_CHECK_EQUAL(mnman.PushListEntries(&node, vDigest), 0);
+    BOOST_CHECK(GetAnnounced(node).empty());
+
+    // a differing bucket sends only the entries of that bucket
+    std::vector<uint256> vDigestPeer = vDigest;
+    vDigestPeer[1] = uint256();
+    BOOST_CHECK_EQUAL(mnman.PushListEntries(&node, vDigestPeer), 2);
+    const std::set<uint256> setBucket{CMasternodeBroadcast(vMasternodes[0]).GetHash(), CMasternodeBroadcast(vMasternodes[1]).GetHash()};
+    BOOST_CHECK(GetAnnounced(node) == setBucket);
+
+    // a peer without a list gets all of it
+    BOOST_CHECK_EQUAL(mnman.PushListEntries(&node, std::vector<uint256>(MASTERNODES_DIGEST_BUCKETS)), 3);
+    BOOST_CHECK_EQUAL(GetAnnounced(node).size(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chainparams.h>
 #include <coins.h>
 #include <consensus/consensus.h>
@@ -526,4 +527,37 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(pow_search)
+{
+    CBlockHeader header;
+    header.nVersion = CBlockHeader::CURRENT_VERSION;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = 1600000000;
+    header.nBits = 0x207fffff;
+    header.nNonce = 0;
+
+    // An impossible target exhausts the range and tries every nonce once.
+    CPoWSearch search(header);
+    uint256 hash;
+    uint32_t nNonce = 5;
+    BOOST_CHECK(!search.Scan(nNonce, 4, arith_uint256(), hash));
+    BOOST_CHECK_EQUAL(nNonce, 9U);
+    header.nNonce = 8;
+    BOOST_CHECK(hash == header.GetUncachedHash());
+
+    // The easiest target is met by the first nonce.
+    nNonce = 0xfffffffe;
+    BOOST_CHECK(search.Scan(nNonce, 2, ~arith_uint256(), hash));
+    BOOST_CHECK_EQUAL(nNonce, 0xfffffffeU);
+    header.nNonce = nNonce;
+    BOOST_CHECK(hash == header.GetUncachedHash());
+
+    // A changed nTime is picked up.
+    header.nTime += 1;
+    search.UpdateTime(header);
+    BOOST_CHECK(search.Scan(nNonce, 1, ~arith_uint256(), hash));
+    BOOST_CHECK(hash == header.GetUncachedHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
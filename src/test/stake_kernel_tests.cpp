@@ -0,0 +1,36 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pos/kernel.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(stake_kernel_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stake_kernel_matches_stakehash)
+{
+    for (int i = 0; i < 100; ++i) {
+        const uint64_t nStakeModifier = InsecureRandBits(64);
+        const unsigned int nTimeBlockFrom = InsecureRand32();
+        const COutPoint prevout(InsecureRand256(), InsecureRandRange(100));
+        const int64_t nValueIn = InsecureRandRange(1000000) * COIN;
+        // Easy enough targets that some attempts hit and some miss.
+        const unsigned int nBits = 0x1d000000 | InsecureRandBits(24);
+
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nStakeModifier;
+        const CStakeKernel kernel(nStakeModifier, nTimeBlockFrom, prevout, nValueIn, nBits);
+        arith_uint256 bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+
+        for (unsigned int nTimeTx = nTimeBlockFrom; nTimeTx < nTimeBlockFrom + 16; ++nTimeTx) {
+            const uint256 hash = stakeHash(nTimeTx, ss, prevout.n, prevout.hash, nTimeBlockFrom);
+            BOOST_CHECK(kernel.GetHash(nTimeTx) == hash);
+            BOOST_CHECK_EQUAL(kernel.CheckHash(hash), stakeTargetHit(hash, nValueIn, ArithToUint256(bnTargetPerCoinDay)));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,96 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pos/cache.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+std::pair<COutPoint, unsigned int> RandomKernel()
+{
+    return std::make_pair(COutPoint(InsecureRand256(), InsecureRandRange(10)), InsecureRand32());
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(stake_seen_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stake_seen_duplicate)
+{
+    CStakeSeen seen;
+    const auto kernel = RandomKernel();
+    const uint256 hashBlock = InsecureRand256();
+
+    BOOST_CHECK(!seen.IsDuplicate(kernel, hashBlock));
+    seen.Add(kernel, hashBlock, 100, 0);
+    BOOST_CHECK_EQUAL(seen.Size(), 1U);
+
+    // the block that staked the kernel is not a duplicate of itself
+    BOOST_CHECK(!seen.IsDuplicate(kernel, hashBlock));
+    // another block with the same outpoint and time is
+    BOOST_CHECK(seen.IsDuplicate(kernel, InsecureRand256()));
+    // the same outpoint at another time is not
+    BOOST_CHECK(!seen.IsDuplicate(std::make_pair(kernel.first, kernel.second + 1), InsecureRand256()));
+    BOOST_CHECK(!seen.IsDuplicate(std::make_pair(COutPoint(kernel.first.hash, kernel.first.n + 1), kernel.second), InsecureRand256()));
+
+    // the first block to stake a kernel is the one remembered
+    seen.Add(kernel, InsecureRand256(), 101, 0);
+    BOOST_CHECK_EQUAL(seen.Size(), 1U);
+    BOOST_CHECK(!seen.IsDuplicate(kernel, hashBlock));
+}
+
+BOOST_AUTO_TEST_CASE(stake_seen_prune)
+{
+    CStakeSeen seen;
+    std::vector<std::pair<COutPoint, unsigned int>> vKernels;
+    for (int nHeight = 1; nHeight <= 10; ++nHeight) {
+        vKernels.push_back(RandomKernel());
+        seen.Add(vKernels.back(), InsecureRand256(), nHeight, 0);
+    }
+    BOOST_CHECK_EQUAL(seen.Size(), 10U);
+
+    // adding a kernel forgets those below the minimum height
+    const auto kernel = RandomKernel();
+    seen.Add(kernel, InsecureRand256(), 11, 6);
+    BOOST_CHECK_EQUAL(seen.Size(), 6U);
+    for (int nHeight = 1; nHeight <= 10; ++nHeight)
+        BOOST_CHECK_EQUAL(seen.IsDuplicate(vKernels[nHeight - 1], InsecureRand256()), nHeight >= 6);
+    BOOST_CHECK(seen.IsDuplicate(kernel, InsecureRand256()));
+
+    // a kernel below the minimum height is not recorded
+    const auto kernelOld = RandomKernel();
+    seen.Add(kernelOld, InsecureRand256(), 5, 6);
+    BOOST_CHECK_EQUAL(seen.Size(), 6U);
+    BOOST_CHECK(!seen.IsDuplicate(kernelOld, InsecureRand256()));
+}
+
+BOOST_AUTO_TEST_CASE(stake_seen_reorg_below_pruned_height)
+{
+    CStakeSeen seen;
+    const int nReorgDepth = 100;
+    const auto kernel = RandomKernel();
+    const uint256 hashBlock = InsecureRand256();
+    seen.Add(kernel, hashBlock, 1000, 1000 - nReorgDepth);
+
+    // a block on another branch restaking the kernel is a duplicate while the
+    // kernel is within reorganization depth
+    const uint256 hashFork = InsecureRand256();
+    BOOST_CHECK(seen.IsDuplicate(kernel, hashFork));
+
+    // the chain moves on past the depth at which the kernel is pruned
+    for (int nHeight = 1001; nHeight <= 1000 + nReorgDepth + 1; ++nHeight)
+        seen.Add(RandomKernel(), InsecureRand256(), nHeight, nHeight - nReorgDepth);
+    BOOST_CHECK(!seen.IsDuplicate(kernel, hashFork));
+
+    // the valid block of a reorganization below the pruned height is accepted,
+    // and is not recorded deeper than the window
+    seen.Add(kernel, hashFork, 1000, 1000 + nReorgDepth + 1 - nReorgDepth);
+    BOOST_CHECK(!seen.IsDuplicate(kernel, hashBlock));
+    BOOST_CHECK(!seen.IsDuplicate(kernel, hashFork));
+    BOOST_CHECK_EQUAL(seen.Size(), (size_t)nReorgDepth + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,51 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/util/masternode.h>
+
+#include <key.h>
+#include <masternode/masternode-payments.h>
+#include <masternode/masternode.h>
+#include <script/standard.h>
+#include <test/util/setup_common.h>
+#include <timedata.h>
+
+CMasternode MakeMasternode(Optional<unsigned char> nBucket)
+{
+    uint256 hash = InsecureRand256();
+    if (nBucket)
+        *hash.begin() = *nBucket;
+
+    CKey key;
+    key.MakeNewKey(true);
+
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(hash, 0));
+    mn.pubKeyCollateralAddress = key.GetPubKey();
+    mn.pubKeyMasternode = key.GetPubKey();
+    mn.sigTime = GetAdjustedTime() - 60 * 60;
+    mn.lastPing.vin = mn.vin;
+    mn.lastPing.sigTime = GetAdjustedTime() - 60;
+    return mn;
+}
+
+CScript RandomPayee()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return GetScriptForDestination(PKHash(key.GetPubKey()));
+}
+
+CMasternodePaymentWinner MakeVote(int nBlockHeight, const CScript& payee)
+{
+    CMasternodePaymentWinner winner(CTxIn(COutPoint(InsecureRand256(), 0)));
+    winner.nBlockHeight = nBlockHeight;
+    winner.AddPayee(payee);
+    return winner;
+}
+
+CMasternodePaymentWinner MakeVote(int nBlockHeight)
+{
+    return MakeVote(nBlockHeight, RandomPayee());
+}
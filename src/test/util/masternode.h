@@ -0,0 +1,27 @@
+// Copyright (c) 2018-2020 The HodlCash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TEST_UTIL_MASTERNODE_H
+#define BITCOIN_TEST_UTIL_MASTERNODE_H
+
+#include <optional.h>
+
+class CMasternode;
+class CMasternodePaymentWinner;
+class CScript;
+
+/**
+ * An enabled masternode with a random collateral and key. When nBucket is
+ * given, the collateral falls in that list digest bucket.
+ */
+CMasternode MakeMasternode(Optional<unsigned char> nBucket = nullopt);
+
+/** A pay-to-pubkey-hash script of a new key */
+CScript RandomPayee();
+
+/** A vote from a random masternode for payee at nBlockHeight */
+CMasternodePaymentWinner MakeVote(int nBlockHeight, const CScript& payee);
+CMasternodePaymentWinner MakeVote(int nBlockHeight);
+
+#endif // BITCOIN_TEST_UTIL_MASTERNODE_H
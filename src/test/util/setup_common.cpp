@@ -9,6 +9,7 @@
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/argon2m.h>
 #include <crypto/sha256.h>
 #include <init.h>
 #include <miner.h>
@@ -76,6 +77,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     InitLogging();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    Argon2mAutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
@@ -131,6 +133,7 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
     constexpr int script_check_threads = 2;
     for (int i = 0; i < script_check_threads; ++i) {
         threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadBlockProofCheck(i); });
     }
     g_parallel_script_checks = true;
 
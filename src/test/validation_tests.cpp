@@ -3,7 +3,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <checkqueue.h>
+#include <key.h>
 #include <net.h>
+#include <pos/kernel.h>
+#include <script/standard.h>
 #include <validation.h>
 
 #include <test/util/setup_common.h>
@@ -74,4 +78,106 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+/** A proof-of-stake block staking prevout to key, signed with signer */
+static CBlock MakeStakeBlock(const COutPoint& prevout, const CKey& key, const CKey& signer, const uint256& hashPrevBlock = uint256())
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+
+    CMutableTransaction coinstake;
+    coinstake.vin.emplace_back(prevout);
+    coinstake.vout.resize(2);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout[1] = CTxOut(200, GetScriptForRawPubKey(key.GetPubKey()));
+
+    CBlock block;
+    block.hashPrevBlock = hashPrevBlock;
+    block.nTime = 1600000000;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(coinstake));
+    BOOST_CHECK(block.IsProofOfStake());
+
+    BOOST_CHECK(signer.Sign(block.GetHash(), block.vchBlockSig));
+    return block;
+}
+
+/** Run the proof checks of a block inline, as ConnectBlock does without script check threads */
+static bool CheckProofsSerial(std::vector<CBlockProofCheck> vChecks)
+{
+    for (CBlockProofCheck& check : vChecks) {
+        if (!check())
+            return false;
+    }
+    return true;
+}
+
+/** Run the proof checks of a block on worker threads, as ConnectBlock does with script check threads */
+static bool CheckProofsParallel(CCheckQueue<CBlockProofCheck>& queue, std::vector<CBlockProofCheck> vChecks)
+{
+    CCheckQueueControl<CBlockProofCheck> control(&queue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
+BOOST_AUTO_TEST_CASE(block_proof_check)
+{
+    CCheckQueue<CBlockProofCheck> queue(1);
+    boost::thread_group tg;
+    for (int i = 0; i < 2; ++i)
+        tg.create_thread([&]{ queue.Thread(); });
+
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    const COutPoint prevout(uint256S("0x0badc0de"), 1);
+
+    const CBlock block = MakeStakeBlock(prevout, key, key);
+    const CBlock badSigBlock = MakeStakeBlock(prevout, key, otherKey);
+
+    // (value / 100) * target per coin day is close to the largest hash, and 1
+    const auto goodKernel = std::make_shared<const CStakeKernel>(0, block.nTime - 3600, prevout, 200, 0x207fffff);
+    const auto badKernel = std::make_shared<const CStakeKernel>(0, block.nTime - 3600, prevout, 100, 0x03000001);
+    BOOST_REQUIRE(goodKernel->CheckHash(goodKernel->GetHash(block.nTime)));
+    BOOST_REQUIRE(!badKernel->CheckHash(badKernel->GetHash(block.nTime)));
+
+    const std::vector<CBlockProofCheck> vValid{CBlockProofCheck(block, goodKernel), CBlockProofCheck(block, false)};
+    const std::vector<CBlockProofCheck> vBadKernel{CBlockProofCheck(block, badKernel), CBlockProofCheck(block, false)};
+    const std::vector<CBlockProofCheck> vBadSig{CBlockProofCheck(badSigBlock, goodKernel), CBlockProofCheck(badSigBlock, false)};
+
+    BOOST_CHECK(CheckProofsSerial(vValid));
+    BOOST_CHECK(!CheckProofsSerial(vBadKernel));
+    BOOST_CHECK(!CheckProofsSerial(vBadSig));
+
+    BOOST_CHECK(CheckProofsParallel(queue, vValid));
+    BOOST_CHECK(!CheckProofsParallel(queue, vBadKernel));
+    BOOST_CHECK(!CheckProofsParallel(queue, vBadSig));
+
+    // a signature cached while testing the block does not let a bad one through later
+    BOOST_CHECK(CheckProofsSerial({CBlockProofCheck(block, true)}));
+    BOOST_CHECK(CheckProofsParallel(queue, vValid));
+    BOOST_CHECK(!CheckProofsParallel(queue, vBadSig));
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(block_bad_signature_not_stored)
+{
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+
+    // a copy of a block with its signature corrupted is neither stored nor
+    // marked failed, so the block itself is still accepted later
+    const uint256 hashTip = WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash());
+    const CBlock block = MakeStakeBlock(COutPoint(uint256S("0x0badc0de"), 1), key, otherKey, hashTip);
+
+    bool fNewBlock = true;
+    BOOST_CHECK(!ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, &fNewBlock));
+    BOOST_CHECK(!fNewBlock);
+    BOOST_CHECK(WITH_LOCK(cs_main, return LookupBlockIndex(block.GetHash())) == nullptr);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -53,6 +53,7 @@
 #include <masternode/masternodeman.h>
 #include <masternode/masternode-payments.h>
 #include <masternode/spork.h>
+#include <pos/cache.h>
 #include <pos/kernel.h>
 
 #include <string>
@@ -67,9 +68,6 @@
 #define MICRO 0.000001
 #define MILLI 0.001
 
-std::map<uint256, uint256> mapProofOfStake;
-std::map<unsigned int, unsigned int> mapHashedBlocks;
-std::set<std::pair<uint256, unsigned int> > setStakeSeen;
 
 bool CBlockIndexWorkComparator::operator()(const CBlockIndex *pa, const CBlockIndex *pb) const {
     // First sort by most total work, ...
@@ -1979,6 +1977,61 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+bool CHeaderHashCheck::operator()() {
+    pheader->GetHash();
+    return true;
+}
+
+// Each job is a full argon2m evaluation, so hand them out in small batches to
+// keep the workers evenly loaded.
+static CCheckQueue<CHeaderHashCheck> headerhashqueue(8);
+
+void ThreadHeaderHashCheck(int worker_num) {
+    util::ThreadRename(strprintf("hdrhash.%i", worker_num));
+    headerhashqueue.Thread();
+}
+
+bool CBlockProofCheck::operator()() {
+    if (!kernel) {
+        if (!CheckBlockSignature(*pblock, cacheStore))
+            return error("%s: bad signature on block %s", __func__, pblock->GetHash().ToString());
+        return true;
+    }
+
+    const uint256 hashProofOfStake = kernel->GetHash(pblock->nTime);
+    if (!kernel->CheckHash(hashProofOfStake))
+        return error("%s: check kernel failed on coinstake %s, hashProof=%s", __func__, pblock->vtx[1]->GetHash().ToString(), hashProofOfStake.ToString());
+    LogPrint(BCLog::POS, "hashProof %s\n", hashProofOfStake.ToString());
+    return true;
+}
+
+// A block has at most two proof checks, so hand them out one at a time to
+// let the kernel hash and the signature run on different threads.
+static CCheckQueue<CBlockProofCheck> blockproofqueue(1);
+
+void ThreadBlockProofCheck(int worker_num) {
+    util::ThreadRename(strprintf("blkproof.%i", worker_num));
+    blockproofqueue.Thread();
+}
+
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    AssertLockNotHeld(cs_main);
+
+    // Header hashing threads are started together with the script check threads.
+    if (headers.size() < 2 || !g_parallel_script_checks)
+        return;
+
+    std::vector<CHeaderHashCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (const CBlockHeader& header : headers)
+        vChecks.emplace_back(header);
+
+    CCheckQueueControl<CHeaderHashCheck> control(&headerhashqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -2145,12 +2198,44 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "ConnectBlock(): PoW period ended",
                              "pow-ended");
 
-    uint256 hashProofOfStake = uint256();
+    // The stake kernel is looked up now, before the block spends the staked
+    // output from view. Its hash and the block signature are then checked
+    // alongside the scripts. CreateNewBlock tests proof-of-stake templates
+    // before they are signed, so only a block that is just being checked may
+    // come without a signature. A signature checked then is cached for when
+    // the block is connected.
+    std::vector<CBlockProofCheck> vProofChecks;
     if (block.IsProofOfStake()) {
-        if (!CheckProofOfStake(block, hashProofOfStake))
-            return false;
-        else
-            LogPrint(BCLog::POS, "hashProof %s\n", hashProofOfStake.ToString().c_str());
+        std::shared_ptr<const CStakeKernel> kernel = GetProofOfStakeKernel(block, pindex->pprev, view);
+        if (!kernel)
+            return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-blk-proof", "stake kernel not found");
+        vProofChecks.emplace_back(block, std::move(kernel));
+    }
+    const bool fCheckSignature = !fJustCheck || !block.vchBlockSig.empty();
+    if (fCheckSignature)
+        vProofChecks.emplace_back(block, fJustCheck);
+
+    // The signature is not covered by the block hash, so a bad one must not
+    // mark the block failed: a peer could otherwise relay a copy with its
+    // signature corrupted to get the real block rejected. Blocks are only
+    // stored once their signature checked, so one that fails here is corrupt.
+    auto ProofFailed = [&]() {
+        if (fCheckSignature && !CheckBlockSignature(block, false)) {
+            if (!fJustCheck)
+                return AbortNode(state, "Corrupt block signature found indicating potential hardware failure; shutting down");
+            return state.Invalid(BlockValidationResult::BLOCK_MUTATED, "bad-blk-sig", "bad block signature");
+        }
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-blk-proof");
+    };
+
+    CCheckQueueControl<CBlockProofCheck> proofcontrol(g_parallel_script_checks ? &blockproofqueue : nullptr);
+    if (g_parallel_script_checks) {
+        proofcontrol.Add(vProofChecks);
+    } else {
+        for (CBlockProofCheck& check : vProofChecks) {
+            if (!check())
+                return ProofFailed();
+        }
     }
 
     bool fScriptChecks = true;
@@ -2404,12 +2489,22 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         }
     }
 
+    if (!proofcontrol.Wait()) {
+        LogPrintf("ERROR: %s: block proof CheckQueue failed\n", __func__);
+        return ProofFailed();
+    }
+
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
     if (fJustCheck)
         return true;
 
+    // The kernel is only recorded once the block's proof and signature
+    // checked, so a copy that fails them cannot claim it first
+    if (block.IsProofOfStake())
+        stakeSeen.Add(block.GetProofOfStake(), block.GetHash(), pindex->nHeight, pindex->nHeight - chainparams.GetConsensus().nMaxReorganizationDepth);
+
     if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
 
@@ -2732,6 +2827,7 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
     }
 
     m_chain.SetTip(pindexDelete->pprev);
+    stakeModifiers.BlockDisconnected(pindexDelete);
 
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
@@ -2838,6 +2934,7 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     disconnectpool.removeForBlock(blockConnecting.vtx);
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
+    stakeModifiers.BlockConnected(pindexNew);
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
@@ -3381,10 +3478,6 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
     pindexNew->nSequenceId = 0;
     BlockMap::iterator mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
 
-    //mark as PoS seen
-    if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(std::make_pair(hash, pindexNew->nTime));
-
     pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = m_block_index.find(block.hashPrevBlock);
     if (miPrev != m_block_index.end())
@@ -4036,6 +4129,12 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, Block
         // low-work blocks on a fake chain that we would never
         // request; don't process these.
         if (pindex->nChainWork < nMinimumChainWork) return true;
+
+        // Don't process copies of a recently connected block restaking its kernel
+        if (block.IsProofOfStake() && stakeSeen.IsDuplicate(block.GetProofOfStake(), block.GetHash())) {
+            LogPrint(BCLog::POS, "%s: ignoring unrequested block %s, duplicate stake\n", __func__, block.GetHash().ToString());
+            return true;
+        }
     }
 
     if (!CheckBlock(block, state, chainparams.GetConsensus()) ||
@@ -4074,8 +4173,14 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 {
     AssertLockNotHeld(cs_main);
 
-    if (!CheckBlockSignature(*pblock))
-        return error("%s : bad proof-of-stake block signature", __func__);
+    // Checked before the block is stored, as a bad signature leaves the block
+    // hash valid. The verified signature is cached for ConnectBlock.
+    if (!CheckBlockSignature(*pblock)) {
+        BlockValidationState state;
+        state.Invalid(BlockValidationResult::BLOCK_MUTATED, "bad-blk-sig", "bad block signature");
+        GetMainSignals().BlockChecked(*pblock, state);
+        return error("%s: bad proof-of-stake block signature", __func__);
+    }
 
     {
         CBlockIndex *pindex = nullptr;
@@ -4982,7 +5087,9 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
                     CBlockIndex* pindex = LookupBlockIndex(hash);
                     if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
                       BlockValidationState state;
-                      if (::ChainstateActive().AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
+                      if (!CheckBlockSignature(*pblock)) {
+                          LogPrintf("%s: skipping block %s with a bad signature\n", __func__, hash.ToString());
+                      } else if (::ChainstateActive().AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
                           nLoaded++;
                       }
                       if (state.IsError()) {
@@ -5019,7 +5126,8 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
                                     head.ToString());
                             LOCK(cs_main);
                             BlockValidationState dummy;
-                            if (::ChainstateActive().AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                            if (CheckBlockSignature(*pblockrecursive) &&
+                                ::ChainstateActive().AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
                             {
                                 nLoaded++;
                                 queue.push_back(pblockrecursive->GetHash());
@@ -41,6 +41,7 @@ class CInv;
 class CConnman;
 class CScriptCheck;
 class CBlockPolicyEstimator;
+class CStakeKernel;
 class CTxMemPool;
 class TxValidationState;
 struct ChainTxData;
@@ -140,7 +141,6 @@ extern RecursiveMutex cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
 typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
-extern std::map<unsigned int, unsigned int> mapHashedBlocks;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
 extern uint256 g_best_block;
@@ -243,6 +243,16 @@ bool LoadBlockIndex(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Run an instance of the header hashing thread */
+void ThreadHeaderHashCheck(int worker_num);
+/** Run an instance of the block proof checking thread */
+void ThreadBlockProofCheck(int worker_num);
+/**
+ * Compute the proof-of-work hashes of a batch of headers in parallel, so that
+ * the sequential checks done afterwards under cs_main only hit the memo.
+ * Does nothing when no worker threads were started.
+ */
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers) LOCKS_EXCLUDED(cs_main);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr);
 /**
@@ -357,6 +367,54 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the argon2m hashing of one block header, used to spread
+ * the proof-of-work hashing of a whole headers message over worker threads.
+ * The result is kept in the header's hash memo.
+ */
+class CHeaderHashCheck
+{
+private:
+    const CBlockHeader* pheader;
+
+public:
+    CHeaderHashCheck(): pheader(nullptr) {}
+    explicit CHeaderHashCheck(const CBlockHeader& headerIn): pheader(&headerIn) {}
+
+    bool operator()();
+
+    void swap(CHeaderHashCheck& check) {
+        std::swap(pheader, check.pheader);
+    }
+};
+
+/**
+ * Closure representing one check of a block's proof that does not depend on
+ * its transactions: the proof-of-stake kernel hash when a kernel is given,
+ * the block signature otherwise. These run on their own queue while the
+ * block's scripts are checked.
+ */
+class CBlockProofCheck
+{
+private:
+    const CBlock* pblock;
+    std::shared_ptr<const CStakeKernel> kernel;
+    bool cacheStore;
+
+public:
+    CBlockProofCheck(): pblock(nullptr), cacheStore(false) {}
+    CBlockProofCheck(const CBlock& blockIn, bool cacheIn): pblock(&blockIn), cacheStore(cacheIn) {}
+    CBlockProofCheck(const CBlock& blockIn, std::shared_ptr<const CStakeKernel> kernelIn): pblock(&blockIn), kernel(std::move(kernelIn)), cacheStore(false) {}
+
+    bool operator()();
+
+    void swap(CBlockProofCheck& check) {
+        std::swap(pblock, check.pblock);
+        std::swap(kernel, check.kernel);
+        std::swap(cacheStore, check.cacheStore);
+    }
+};
+
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
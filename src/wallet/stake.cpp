@@ -7,50 +7,146 @@
 
 #include <wallet/stake.h>
 
+#include <checkqueue.h>
 #include <key_io.h>
 #include <masternode/masternode-payments.h>
 #include <policy/policy.h>
+#include <pos/cache.h>
 #include <pos/kernel.h>
+#include <util/threadnames.h>
 #include <wallet/coincontrol.h>
 
+#include <cmath>
+#include <limits>
+
 CStake stake;
 
-//! performance indicators
-extern int cacheHit;
-extern int cacheMiss;
+static CCheckQueue<CStakeKernelCheck> stakekernelqueue(16);
+
+void ThreadStakeKernelCheck(int worker_num)
+{
+    util::ThreadRename(strprintf("stakecheck.%i", worker_num));
+    stakekernelqueue.Thread();
+}
+
+CStakeSearch::CStakeSearch(unsigned int nBitsIn, unsigned int nTimeTxIn, unsigned int nHashDriftIn, int64_t nMinTimeIn, const uint256& hashTipIn)
+    : nBits(nBitsIn), nTimeTx(nTimeTxIn), nHashDrift(nHashDriftIn), nMinTime(nMinTimeIn), hashTip(hashTipIn)
+{
+    hashBest = uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    dBestDistance = std::numeric_limits<double>::infinity();
+}
+
+bool CStakeSearch::IsDone()
+{
+    if (fDone)
+        return true;
+
+    LOCK(g_best_block_mutex);
+    if (g_best_block != hashTip) {
+        fCancelled = true;
+        fDone = true;
+    }
+    return fDone;
+}
+
+void CStakeSearch::Found(const CStakeCandidate& candidate, unsigned int nTimeTxFound, const uint256& hashProofOfStake)
+{
+    LOCK(cs);
+    if (!winner) {
+        winner = &candidate;
+        nTimeTxWinner = nTimeTxFound;
+        hashWinner = hashProofOfStake;
+    }
+    fDone = true;
+}
+
+void CStakeSearch::Seen(const uint256& hashProofOfStake, double dDistance)
+{
+    LOCK(cs);
+    if (UintToArith256(hashProofOfStake) < UintToArith256(hashBest))
+        hashBest = hashProofOfStake;
+    dBestDistance = std::min(dBestDistance, dDistance);
+}
+
+const CStakeCandidate* CStakeSearch::GetWinner(unsigned int& nTimeTxFound, uint256& hashProofOfStake) const
+{
+    LOCK(cs);
+    nTimeTxFound = nTimeTxWinner;
+    hashProofOfStake = hashWinner;
+    return winner;
+}
+
+uint256 CStakeSearch::GetBestHash() const
+{
+    LOCK(cs);
+    return hashBest;
+}
+
+double CStakeSearch::GetBestDistance() const
+{
+    LOCK(cs);
+    return dBestDistance;
+}
+
+bool CStakeKernelCheck::operator()()
+{
+    if (search->IsDone())
+        return false;
+
+    const CStakeKernel kernel(candidate->nStakeModifier, candidate->nTimeBlockFrom, candidate->prevout, candidate->nValue, search->nBits);
+    arith_uint256 bnBest = ~arith_uint256();
+    uint256 hashBest;
+    unsigned int nHashes = 0;
+
+    // Latest time first, as CheckStakeKernelHash() does
+    for (unsigned int i = 0; i < search->nHashDrift; i++) {
+        const unsigned int nTryTime = search->nTimeTx + search->nHashDrift - i;
+        const uint256 hashProofOfStake = kernel.GetHash(nTryTime);
+        ++nHashes;
+        if (UintToArith256(hashProofOfStake) < bnBest) {
+            bnBest = UintToArith256(hashProofOfStake);
+            hashBest = hashProofOfStake;
+        }
+
+        if (!kernel.CheckHash(hashProofOfStake))
+            continue;
+
+        if (nTryTime <= search->nMinTime) {
+            LogPrint(BCLog::POS, "%s : kernel found, but it is too far in the past\n", __func__);
+            break;
+        }
+
+        search->Hashed(nHashes);
+        search->Seen(hashBest, bnBest.getdouble() / kernel.GetTarget().getdouble());
+        search->Found(*candidate, nTryTime, hashProofOfStake);
+        return false;
+    }
+
+    search->Hashed(nHashes);
+    search->Seen(hashBest, bnBest.getdouble() / kernel.GetTarget().getdouble());
+    return true;
+}
 
 typedef std::vector<unsigned char> valtype;
 bool CStake::SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins, CAmount nTargetAmount) const
 {
     auto m_wallet = GetMainWallet();
-    auto locked_chain = m_wallet->chain().lock();
     LOCK(m_wallet->cs_wallet);
 
-    std::vector<COutput> vCoins;
-    m_wallet->AvailableCoins(*locked_chain, vCoins, true);
+    std::vector<std::pair<const CWalletTx*, unsigned int>> vCoins;
+    m_wallet->AvailableStakeCoins(vCoins, GetAdjustedTime());
     CAmount nAmountSelected = 0;
 
-    for (const COutput& out : vCoins)
+    for (const auto& coin : vCoins)
     {
         //make sure not to outrun target amount
-        if (nAmountSelected + out.tx->tx->vout[out.i].nValue > nTargetAmount)
-            continue;
-
-        //check for min age
-        if (GetAdjustedTime() - out.tx->GetTxTime() < Params().GetConsensus().MinStakeAge())
-            continue;
-
-        //check that it is matured
-        if (out.nDepth < (out.tx->tx->IsCoinStake() ? COINBASE_MATURITY : 10))
-            continue;
-
-        //check that it isnt a collateral type amount
-        if (out.tx->tx->vout[out.i].nValue == Params().GetConsensus().nCollateralAmount)
+        const CAmount nValue = coin.first->tx->vout[coin.second].nValue;
+        if (nAmountSelected + nValue > nTargetAmount)
             continue;
 
         //add to our stake set
-        setCoins.insert(std::make_pair(out.tx, out.i));
-        nAmountSelected += out.tx->tx->vout[out.i].nValue;
+        setCoins.insert(coin);
+        nAmountSelected += nValue;
     }
     return true;
 }
@@ -58,26 +154,16 @@ bool CStake::SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int>
 bool CStake::MintableCoins()
 {
     auto m_wallet = GetMainWallet();
-    auto locked_chain = m_wallet->chain().lock();
     LOCK(m_wallet->cs_wallet);
     SetUsableInputs(false);
 
-    CCoinControl coin_control;
-    CAmount nBalance = m_wallet->GetBalance(0, coin_control.m_avoid_address_reuse).m_mine_trusted;
-    if (nBalance <= 0)
+    std::vector<std::pair<const CWalletTx*, unsigned int>> vCoins;
+    m_wallet->AvailableStakeCoins(vCoins, GetAdjustedTime());
+    if (vCoins.empty())
         return false;
 
-    std::vector<COutput> vCoins;
-    m_wallet->AvailableCoins(*locked_chain, vCoins, true);
-
-    for (const COutput& out : vCoins) {
-        if (GetAdjustedTime() - out.tx->GetTxTime() > Params().GetConsensus().MinStakeAge()) {
-            SetUsableInputs(true);
-            return true;
-        }
-    }
-
-    return false;
+    SetUsableInputs(true);
+    return true;
 }
 
 void CStake::BestStakeSeen(uint256& hash)
@@ -100,8 +186,23 @@ uint256 CStake::ReturnBestStakeSeen()
     return bestHash;
 }
 
+CStakingStats CStake::GetStakingStats() const
+{
+    LOCK(cs_stats);
+    return stats;
+}
+
+/** Add a duration to a staking histogram, see STAKING_STATS_BUCKETS */
+static void AddToHistogram(std::array<uint64_t, STAKING_STATS_BUCKETS>& vBuckets, int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nBucket < STAKING_STATS_BUCKETS - 1 && nMicros >= (int64_t{1000} << nBucket))
+        ++nBucket;
+    ++vBuckets[nBucket];
+}
+
 typedef std::vector<unsigned char> valtype;
-bool CStake::CreateCoinStake(unsigned int nBits, CMutableTransaction& txNew, unsigned int& nTxNewTime)
+bool CStake::CreateCoinStake(const CBlockIndex* pindexPrev, unsigned int nBits, CMutableTransaction& txNew, unsigned int& nTxNewTime)
 {
     txNew.vin.clear();
     txNew.vout.clear();
@@ -116,26 +217,6 @@ bool CStake::CreateCoinStake(unsigned int nBits, CMutableTransaction& txNew, uns
     if (!m_wallet)
         return false;
 
-    CCoinControl coin_control;
-    CAmount nBalance = m_wallet->GetBalance(0, coin_control.m_avoid_address_reuse).m_mine_trusted;
-
-    if (nBalance <= 0)
-        return false;
-
-    static std::set<std::pair<const CWalletTx*, unsigned int>> setStakeCoins;
-    static int nLastStakeSetUpdate = 0;
-
-    if (GetTime() - nLastStakeSetUpdate > nStakeSetUpdateTime) {
-        setStakeCoins.clear();
-        if (!SelectStakeCoins(setStakeCoins, nBalance))
-            return false;
-
-        nLastStakeSetUpdate = GetTime();
-    }
-
-    if (setStakeCoins.empty())
-        return false;
-
     //! required as cwallet isnt acceptable now..
     LegacyScriptPubKeyMan* spk_man = m_wallet->GetLegacyScriptPubKeyMan();
     if (!spk_man) {
@@ -149,89 +230,166 @@ bool CStake::CreateCoinStake(unsigned int nBits, CMutableTransaction& txNew, uns
     std::vector<std::pair<const CWalletTx*, unsigned int>> vwtxPrev;
 
     //! benchmarking variables
-    unsigned int nTries = 0;
     auto s0 = GetTimeMillis();
 
-    for (const auto& pcoin : setStakeCoins) {
-        // Read block header
-        CBlockIndex* blockIndex = LookupBlockIndex(pcoin.first->m_confirm.hashBlock);
-        CBlockHeader block = blockIndex->GetBlockHeader();
-
-        nTries++;
-        bool fKernelFound = false;
-        uint256 hashProofOfStake = uint256();
-        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
-        unsigned int nMaxDrift = Params().GetConsensus().nMaxHashDrift;
-        {
-            bool hashFound = CheckStakeKernelHash(nBits, block, pcoin.first->tx, prevoutStake, nTxNewTime, nMaxDrift, false, hashProofOfStake);
-            BestStakeSeen(hashProofOfStake);
-            if (hashFound) {
-                if (nTxNewTime <= ::ChainActive().Tip()->GetMedianTimePast()) {
-                    LogPrint(BCLog::POS, "%s : kernel found, but it is too far in the past\n", __func__);
-                    continue;
-                }
+    // Copy everything the kernel hash depends on out of the wallet and the
+    // chain, so that the search itself runs without either lock.
+    std::vector<CStakeCandidate> vCandidates;
+    unsigned int nTxNewTimeStart = GetAdjustedTime();
+    unsigned int nMaxDrift = Params().GetConsensus().nMaxHashDrift;
+    int64_t nMedianTimePast;
+    uint256 hashTip;
+    CAmount nBalance = 0;
+    int64_t nLockMicros;
+    {
+        LOCK2(cs_main, m_wallet->cs_wallet);
+        const int64_t nLockStart = GetTimeMicros();
+        nMedianTimePast = pindexPrev->GetMedianTimePast();
+        hashTip = pindexPrev->GetBlockHash();
+        std::vector<std::pair<const CWalletTx*, unsigned int>> vStakeCoins;
+        m_wallet->AvailableStakeCoins(vStakeCoins, nTxNewTimeStart);
+        vCandidates.reserve(vStakeCoins.size());
+        for (const auto& pcoin : vStakeCoins) {
+            nBalance += pcoin.first->tx->vout[pcoin.second].nValue;
+            const CBlockIndex* blockIndex = LookupBlockIndex(pcoin.first->m_confirm.hashBlock);
+            if (!blockIndex)
+                continue;
+
+            CStakeCandidate candidate;
+            candidate.prevout = COutPoint(pcoin.first->GetHash(), pcoin.second);
+            candidate.nValue = pcoin.first->tx->vout[pcoin.second].nValue;
+            candidate.nTimeBlockFrom = blockIndex->GetBlockTime();
+            if (nTxNewTimeStart < candidate.nTimeBlockFrom || candidate.nTimeBlockFrom + Params().GetConsensus().nMinStakeAge > nTxNewTimeStart)
+                continue;
+
+            int nStakeModifierHeight;
+            int64_t nStakeModifierTime;
+            if (!stakeModifiers.Get(blockIndex, candidate.nStakeModifier, nStakeModifierHeight, nStakeModifierTime))
+                continue;
+
+            vCandidates.push_back(candidate);
+        }
+        nLockMicros = GetTimeMicros() - nLockStart;
+    }
 
-                // Found a kernel
-                if (gArgs.GetBoolArg("-printcoinstake", false))
-                    LogPrintf("CreateCoinStake : kernel found\n");
-
-                std::vector<valtype> vSolutions;
-                CScript scriptPubKeyOut;
-                scriptPubKeyKernel = pcoin.first->tx->vout[pcoin.second].scriptPubKey;
-                txnouttype whichType = Solver(scriptPubKeyKernel, vSolutions);
-                if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH && whichType != TX_WITNESS_V0_KEYHASH) {
-                    LogPrint(BCLog::POS, "%s: no support for kernel type=%d\n", __func__, whichType);
-                    break;
-                }
+    CStakeSearch search(nBits, nTxNewTimeStart, nMaxDrift, nMedianTimePast, hashTip);
+    const int64_t nSearchStart = GetTimeMicros();
+    {
+        std::vector<CStakeKernelCheck> vChecks;
+        vChecks.reserve(vCandidates.size());
+        for (const CStakeCandidate& candidate : vCandidates)
+            vChecks.emplace_back(candidate, search);
+
+        CCheckQueueControl<CStakeKernelCheck> control(&stakekernelqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    const int64_t nSearchMicros = GetTimeMicros() - nSearchStart;
 
-                LogPrintf("CStake::CreateCoinStake(): parsed kernel type=%d\n", whichType);
-
-                if (whichType == TX_PUBKEYHASH || whichType == TX_WITNESS_V0_KEYHASH) {
-                    CKey key;
-                    if (!m_wallet->GetLegacyScriptPubKeyMan()->GetKey(CKeyID(uint160(vSolutions[0])), key)) {
-                        LogPrint(BCLog::POS, "%s: failed to get key for kernel type=%d\n", __func__, whichType);
-                        break;
-                    }
-                    scriptPubKeyOut << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
-                } else {
-                    scriptPubKeyOut = scriptPubKeyKernel;
-                }
+    uint256 hashProofOfStake;
+    const CStakeCandidate* winner = search.GetWinner(nTxNewTime, hashProofOfStake);
+    {
+        // Each candidate hits at one timestamp with probability target / 2^256
+        arith_uint256 bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+        CAmount nValue = 0;
+        double dHitsPerSecond = 0;
+        for (const CStakeCandidate& candidate : vCandidates) {
+            nValue += candidate.nValue;
+            dHitsPerSecond += std::min(1.0, std::ldexp((candidate.nValue / 100) * bnTargetPerCoinDay.getdouble(), -256));
+        }
 
-                // continued...
-                txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
-                nCredit += pcoin.first->tx->vout[pcoin.second].nValue;
-                vwtxPrev.push_back(pcoin);
-                txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
-                const CBlockIndex* pIndex0 = ::ChainActive().Tip();
-                uint64_t nTotalSize = pcoin.first->tx->vout[pcoin.second].nValue + GetBlockSubsidy(pIndex0->nHeight, Params().GetConsensus());
+        LOCK(cs_stats);
+        stats.nSearches++;
+        stats.nFound += winner ? 1 : 0;
+        stats.nCancelled += search.IsCancelled() ? 1 : 0;
+        stats.nHashes += search.GetHashes();
+        stats.nSearchMicros += nSearchMicros;
+        stats.nLockMicros += nLockMicros;
+        AddToHistogram(stats.vSearchMillis, nSearchMicros);
+        AddToHistogram(stats.vLockMillis, nLockMicros);
+        stats.nLastTime = nTxNewTimeStart;
+        stats.nLastCoins = vCandidates.size();
+        stats.nLastValue = nValue;
+        stats.nLastHashes = search.GetHashes();
+        stats.nLastSearchMicros = nSearchMicros;
+        stats.nLastLockMicros = nLockMicros;
+        stats.dLastBestDistance = vCandidates.empty() ? 0 : search.GetBestDistance();
+        stats.dLastExpectedTime = dHitsPerSecond > 0 ? 1 / dHitsPerSecond : 0;
+    }
 
-                // stakesplitthreshold in multiples of COIN
-                if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
-                    txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+    uint256 hashBestSeen = search.GetBestHash();
+    BestStakeSeen(hashBestSeen);
+
+    if (search.IsCancelled())
+        LogPrint(BCLog::POS, "%s : chain tip changed, kernel search cancelled\n", __func__);
+
+    if (winner) {
+        LOCK2(cs_main, m_wallet->cs_wallet);
+        // Only the winner goes back to the wallet: it must still be ours and
+        // unspent, and its kernel must pass the consensus check.
+        const CWalletTx* wtx = m_wallet->GetWalletTx(winner->prevout.hash);
+        const CBlockIndex* blockIndex = wtx ? LookupBlockIndex(wtx->m_confirm.hashBlock) : nullptr;
+        uint256 hashCheck;
+        unsigned int nTimeCheck = nTxNewTime;
+        if (!wtx || !blockIndex || m_wallet->IsSpent(winner->prevout.hash, winner->prevout.n) ||
+            !CheckStakeKernelHash(nBits, blockIndex, wtx->tx->vout[winner->prevout.n].nValue, winner->prevout, nTimeCheck, 0, true, hashCheck)) {
+            LogPrint(BCLog::POS, "%s : kernel %s no longer valid\n", __func__, winner->prevout.ToString());
+        } else {
+            const auto pcoin = std::make_pair(wtx, winner->prevout.n);
+
+            // Found a kernel
+            if (gArgs.GetBoolArg("-printcoinstake", false))
+                LogPrintf("CreateCoinStake : kernel found\n");
+
+            std::vector<valtype> vSolutions;
+            CScript scriptPubKeyOut;
+            scriptPubKeyKernel = pcoin.first->tx->vout[pcoin.second].scriptPubKey;
+            txnouttype whichType = Solver(scriptPubKeyKernel, vSolutions);
+            if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH && whichType != TX_WITNESS_V0_KEYHASH) {
+                LogPrint(BCLog::POS, "%s: no support for kernel type=%d\n", __func__, whichType);
+                return false;
+            }
 
-                if (gArgs.GetBoolArg("-printcoinstake", false))
-                    LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
+            LogPrintf("CStake::CreateCoinStake(): parsed kernel type=%d\n", whichType);
 
-                fKernelFound = true;
-                break;
+            if (whichType == TX_PUBKEYHASH || whichType == TX_WITNESS_V0_KEYHASH) {
+                CKey key;
+                if (!m_wallet->GetLegacyScriptPubKeyMan()->GetKey(CKeyID(uint160(vSolutions[0])), key)) {
+                    LogPrint(BCLog::POS, "%s: failed to get key for kernel type=%d\n", __func__, whichType);
+                    return false;
+                }
+                scriptPubKeyOut << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+            } else {
+                scriptPubKeyOut = scriptPubKeyKernel;
             }
-            if (fKernelFound)
-                break;
+
+            // continued...
+            txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
+            nCredit += pcoin.first->tx->vout[pcoin.second].nValue;
+            vwtxPrev.push_back(pcoin);
+            txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+            uint64_t nTotalSize = pcoin.first->tx->vout[pcoin.second].nValue + GetBlockSubsidy(pindexPrev->nHeight, Params().GetConsensus());
+
+            // stakesplitthreshold in multiples of COIN
+            if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
+                txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+
+            if (gArgs.GetBoolArg("-printcoinstake", false))
+                LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
         }
     }
 
     auto s1 = GetTimeMillis();
     auto timetaken = s1 - s0;
-    LogPrintf("%s - took %dms to iterate %d inputs (%d hit %d miss)\n", __func__, timetaken, nTries, cacheHit, cacheMiss);
+    LogPrintf("%s - took %dms to search %d inputs (%d hit %d miss)\n", __func__, timetaken, vCandidates.size(), cacheHit.load(), cacheMiss.load());
 
     if (nCredit == 0 || nCredit > nBalance)
         return false;
 
     // Calculate reward
     CAmount nReward;
-    const CBlockIndex* pIndex0 = ::ChainActive().Tip();
-    nReward = GetBlockSubsidy(pIndex0->nHeight, Params().GetConsensus());
+    nReward = GetBlockSubsidy(pindexPrev->nHeight, Params().GetConsensus());
     nCredit += nReward;
 
     CAmount nMinFee = 0;
@@ -271,7 +429,6 @@ bool CStake::CreateCoinStake(unsigned int nBits, CMutableTransaction& txNew, uns
     }
 
     // Successfully generated coinstake
-    nLastStakeSetUpdate = 0; //this will trigger stake set to repopulate next round
     return true;
 }
 
@@ -16,9 +16,116 @@
 #include <util/system.h>
 #include <wallet/wallet.h>
 
+#include <array>
+#include <atomic>
+
 class CStake;
 extern CStake stake;
 
+/** Kernel inputs of one stakeable output, copied out of the wallet so the search needs no locks. */
+struct CStakeCandidate
+{
+    COutPoint prevout;
+    CAmount nValue;
+    unsigned int nTimeBlockFrom;
+    uint64_t nStakeModifier;
+};
+
+/**
+ * State shared by the workers of one kernel search: its parameters, the
+ * winning candidate and the best hash seen. The search is over once a
+ * kernel is found or the chain tip moves away from hashTip.
+ */
+class CStakeSearch
+{
+public:
+    const unsigned int nBits;
+    const unsigned int nTimeTx;
+    const unsigned int nHashDrift;
+    //! Kernel times at or below this (the tip's median time past) are unusable
+    const int64_t nMinTime;
+
+    CStakeSearch(unsigned int nBitsIn, unsigned int nTimeTxIn, unsigned int nHashDriftIn, int64_t nMinTimeIn, const uint256& hashTipIn);
+
+    bool IsDone();
+    bool IsCancelled() const { return fCancelled; }
+    void Found(const CStakeCandidate& candidate, unsigned int nTimeTxFound, const uint256& hashProofOfStake);
+    /** Record a candidate's best hash and its ratio to that candidate's target */
+    void Seen(const uint256& hashProofOfStake, double dDistance);
+    void Hashed(unsigned int nCount) { nHashes += nCount; }
+
+    const CStakeCandidate* GetWinner(unsigned int& nTimeTxFound, uint256& hashProofOfStake) const;
+    uint256 GetBestHash() const;
+    double GetBestDistance() const;
+    uint64_t GetHashes() const { return nHashes; }
+
+private:
+    const uint256 hashTip;
+    std::atomic<bool> fDone{false};
+    std::atomic<bool> fCancelled{false};
+    std::atomic<uint64_t> nHashes{0};
+
+    mutable Mutex cs;
+    const CStakeCandidate* winner GUARDED_BY(cs){nullptr};
+    unsigned int nTimeTxWinner GUARDED_BY(cs){0};
+    uint256 hashWinner GUARDED_BY(cs);
+    uint256 hashBest GUARDED_BY(cs);
+    double dBestDistance GUARDED_BY(cs);
+};
+
+/**
+ * Closure representing the kernel search over one candidate's drift window.
+ * Returns false once the search is over, which makes the check queue skip
+ * the remaining candidates.
+ */
+class CStakeKernelCheck
+{
+private:
+    const CStakeCandidate* candidate;
+    CStakeSearch* search;
+
+public:
+    CStakeKernelCheck(): candidate(nullptr), search(nullptr) {}
+    CStakeKernelCheck(const CStakeCandidate& candidateIn, CStakeSearch& searchIn): candidate(&candidateIn), search(&searchIn) {}
+
+    bool operator()();
+
+    void swap(CStakeKernelCheck& check) {
+        std::swap(candidate, check.candidate);
+        std::swap(search, check.search);
+    }
+};
+
+/** Run an instance of the stake kernel checking thread */
+void ThreadStakeKernelCheck(int worker_num);
+
+//! Buckets of the staking histograms: bucket i counts durations under 2^i ms, the last one the rest
+static const int STAKING_STATS_BUCKETS = 12;
+
+/** Kernel search statistics: totals since startup and the latest search */
+struct CStakingStats
+{
+    uint64_t nSearches{0};
+    uint64_t nFound{0};
+    uint64_t nCancelled{0};
+    uint64_t nHashes{0};
+    int64_t nSearchMicros{0};
+    int64_t nLockMicros{0};
+    std::array<uint64_t, STAKING_STATS_BUCKETS> vSearchMillis{};
+    std::array<uint64_t, STAKING_STATS_BUCKETS> vLockMillis{};
+
+    int64_t nLastTime{0};
+    uint64_t nLastCoins{0};
+    CAmount nLastValue{0};
+    uint64_t nLastHashes{0};
+    int64_t nLastSearchMicros{0};
+    int64_t nLastLockMicros{0};
+    //! Best hash over its candidate's target; a kernel needs less than 1
+    double dLastBestDistance{0};
+    //! Expected seconds to a kernel with the latest search's coins and target
+    double dLastExpectedTime{0};
+};
+
 /**
  * CStake class deals with coin minting, to be at an arms distance from wallet.cpp..
  */
@@ -28,20 +135,24 @@ private:
     uint256 bestHash{};
     bool usableInputs{false};
 
+    mutable Mutex cs_stats;
+    CStakingStats stats GUARDED_BY(cs_stats);
+
 public:
     unsigned int nStakeSplitThreshold = 2000;
     unsigned int nHashInterval = 22;
-    int nStakeSetUpdateTime = 300;
 
     bool HasUsableInputs() { return usableInputs; }
     void SetUsableInputs(bool userhasinputs) { usableInputs = userhasinputs; }
 
     bool MintableCoins();
     bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, CAmount nTargetAmount) const;
-    bool CreateCoinStake(unsigned int nBits, CMutableTransaction& txNew, unsigned int& nTxNewTime);
+    /** Search for a kernel and build the coinstake for a block on top of pindexPrev */
+    bool CreateCoinStake(const CBlockIndex* pindexPrev, unsigned int nBits, CMutableTransaction& txNew, unsigned int& nTxNewTime);
     void BestStakeSeen(uint256& hash);
     void ResetBestStakeSeen();
     uint256 ReturnBestStakeSeen();
+    CStakingStats GetStakingStats() const;
 };
 
 #endif // BITCOIN_WALLET_STAKE_H
@@ -8,6 +8,8 @@
 #include <stdint.h>
 #include <vector>
 
+#include <chainparams.h>
+#include <consensus/validation.h>
 #include <interfaces/chain.h>
 #include <node/context.h>
 #include <policy/policy.h>
@@ -574,6 +576,141 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+class StakeCoinsTestingSetup : public ListCoinsTestingSetup
+{
+public:
+    /** Mine txns and tell the wallet, as the validation interface would */
+    void MineBlock(const std::vector<CMutableTransaction>& txns)
+    {
+        const CBlock block = CreateAndProcessBlock(txns, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+        wallet->blockConnected(block, WITH_LOCK(cs_main, return ::ChainActive().Height()));
+    }
+
+    void DisconnectTip()
+    {
+        CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        BlockValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), pindex));
+        wallet->blockDisconnected(block, pindex->nHeight);
+    }
+
+    /** Commit a payment to ourselves without mining it */
+    CTransactionRef SendToSelf(CAmount nAmount)
+    {
+        CTransactionRef tx;
+        CAmount fee;
+        int changePos = -1;
+        std::string error;
+        CCoinControl dummy;
+        {
+            auto locked_chain = m_chain->lock();
+            BOOST_CHECK(wallet->CreateTransaction(*locked_chain, {{GetScriptForRawPubKey(coinbaseKey.GetPubKey()), nAmount, false}}, tx, fee, changePos, error, dummy));
+        }
+        wallet->CommitTransaction(tx, {}, {});
+        return tx;
+    }
+
+    /** Compare the stake coin index with a full AvailableCoins scan */
+    void CheckStakeCoins(int64_t nTime)
+    {
+        const Consensus::Params& consensus = Params().GetConsensus();
+        auto locked_chain = m_chain->lock();
+        LOCK(wallet->cs_wallet);
+
+        std::vector<std::pair<const CWalletTx*, unsigned int>> vStakeCoins;
+        wallet->AvailableStakeCoins(vStakeCoins, nTime);
+        BOOST_CHECK(wallet->fStakeCoinsIndexed);
+        std::vector<COutput> vCoins;
+        wallet->AvailableCoins(*locked_chain, vCoins);
+
+        // every indexed coin is either maturing or eligible
+        BOOST_CHECK_EQUAL(wallet->mapStakeCoins.size(), wallet->setStakeMaturing.size() + wallet->setStakeEligible.size());
+        for (const auto& entry : wallet->setStakeMaturing) {
+            BOOST_CHECK(wallet->mapStakeCoins.count(entry.second));
+            BOOST_CHECK(!wallet->setStakeEligible.count(entry.second));
+        }
+        for (const COutPoint& outpoint : wallet->setStakeEligible)
+            BOOST_CHECK(wallet->mapStakeCoins.count(outpoint));
+
+        // the index holds the confirmed, spendable, non-collateral outputs the
+        // scan returns, and the immature coinbase outputs it leaves out
+        std::set<COutPoint> setConfirmed;
+        std::set<std::pair<const CWalletTx*, unsigned int>> setExpected;
+        for (const COutput& out : vCoins) {
+            if (out.nDepth < 1 || !out.fSpendable || out.tx->tx->vout[out.i].nValue == consensus.nCollateralAmount)
+                continue;
+            setConfirmed.emplace(out.tx->GetHash(), out.i);
+
+            // the selection rules the index replaced
+            if (nTime - out.tx->GetTxTime() < consensus.MinStakeAge())
+                continue;
+            if (out.nDepth < (out.tx->tx->IsCoinStake() ? COINBASE_MATURITY : 10))
+                continue;
+            setExpected.emplace(out.tx, out.i);
+        }
+        for (const COutPoint& outpoint : setConfirmed)
+            BOOST_CHECK(wallet->mapStakeCoins.count(outpoint));
+        for (const auto& entry : wallet->mapStakeCoins) {
+            BOOST_CHECK(entry.second.wtx == &wallet->mapWallet.at(entry.first.hash));
+            BOOST_CHECK(setConfirmed.count(entry.first) || entry.second.wtx->IsImmatureCoinBase());
+            BOOST_CHECK(!wallet->IsSpent(entry.first.hash, entry.first.n));
+        }
+
+        const std::set<std::pair<const CWalletTx*, unsigned int>> setStakeCoins(vStakeCoins.begin(), vStakeCoins.end());
+        BOOST_CHECK(setStakeCoins == setExpected);
+        BOOST_CHECK_EQUAL(vStakeCoins.size(), setExpected.size());
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(stake_coins_index, StakeCoinsTestingSetup)
+{
+    const int64_t nStakeAge = Params().GetConsensus().MinStakeAge();
+    int64_t nTime = GetAdjustedTime();
+
+    // the first call indexes the wallet
+    CheckStakeCoins(nTime);
+
+    // receive: a new coinbase is indexed but waits to mature
+    MineBlock({});
+    CheckStakeCoins(nTime);
+    nTime += nStakeAge;
+    CheckStakeCoins(nTime);
+    const int nReceivedHeight = WITH_LOCK(cs_main, return ::ChainActive().Height());
+
+    // maturity: the coinbase becomes eligible at the block it matures in
+    while (WITH_LOCK(cs_main, return ::ChainActive().Height()) < nReceivedHeight + COINBASE_MATURITY + 1) {
+        MineBlock({});
+        CheckStakeCoins(nTime);
+    }
+
+    // spend: the spent coin leaves the index, the new outputs wait to mature
+    const CTransactionRef txSpend = SendToSelf(10 * COIN);
+    CheckStakeCoins(nTime);
+    MineBlock({CMutableTransaction(*txSpend)});
+    CheckStakeCoins(nTime);
+    nTime += nStakeAge;
+    for (int i = 0; i < 10; ++i) {
+        MineBlock({});
+        CheckStakeCoins(nTime);
+    }
+
+    // abandon: the coins an unmined spend held return
+    const CTransactionRef txAbandon = SendToSelf(10 * COIN);
+    CheckStakeCoins(nTime);
+    BOOST_CHECK(wallet->AbandonTransaction(txAbandon->GetHash()));
+    CheckStakeCoins(nTime);
+
+    // disconnect: coins lose depth, those of the disconnected block leave
+    MineBlock({CMutableTransaction(*SendToSelf(10 * COIN))});
+    CheckStakeCoins(nTime);
+    for (int i = 0; i < 2; ++i) {
+        DisconnectTip();
+        CheckStakeCoins(nTime);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     NodeContext node;
@@ -7,6 +7,7 @@
 #include <wallet/wallet.h>
 
 #include <chain.h>
+#include <chainparams.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
 #include <fs.h>
@@ -304,6 +305,90 @@ void CWallet::setStakingFlag(bool status)
     LogPrintf("setStakingState %s\n", status ? "enabled" : "disabled");
 }
 
+void CWallet::AddStakeCoin(const CWalletTx& wtx, unsigned int n)
+{
+    AssertLockHeld(cs_wallet);
+    if (!wtx.isConfirmed() || n >= wtx.tx->vout.size())
+        return;
+
+    const CTxOut& txout = wtx.tx->vout[n];
+    if (txout.nValue == Params().GetConsensus().nCollateralAmount)
+        return;
+    if (!(IsMine(txout) & ISMINE_SPENDABLE) || IsSpent(wtx.GetHash(), n))
+        return;
+
+    const COutPoint outpoint(wtx.GetHash(), n);
+    // Coinbase and coinstake outputs are spendable, and so may stake, one
+    // block past COINBASE_MATURITY, see CWalletTx::GetBlocksToMaturity()
+    const int nMaturity = (wtx.IsCoinBase() || wtx.tx->IsCoinStake()) ? COINBASE_MATURITY + 1 : 10;
+    const StakeCoin coin{&wtx, wtx.m_confirm.block_height + nMaturity - 1, wtx.GetTxTime() + Params().GetConsensus().MinStakeAge()};
+    if (mapStakeCoins.emplace(outpoint, coin).second)
+        setStakeMaturing.emplace(coin.nEligibleTime, outpoint);
+}
+
+void CWallet::RemoveStakeCoin(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    auto it = mapStakeCoins.find(outpoint);
+    if (it == mapStakeCoins.end())
+        return;
+
+    setStakeMaturing.erase(std::make_pair(it->second.nEligibleTime, outpoint));
+    setStakeEligible.erase(outpoint);
+    mapStakeCoins.erase(it);
+}
+
+void CWallet::UpdateStakeCoins(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (!fStakeCoinsIndexed)
+        return;
+
+    // The transaction's own outputs follow its confirmation status, the
+    // outputs it spends follow whether it still counts as spending them.
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        RemoveStakeCoin(COutPoint(wtx.GetHash(), i));
+        AddStakeCoin(wtx, i);
+    }
+    for (const CTxIn& txin : wtx.tx->vin) {
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it != mapWallet.end()) {
+            RemoveStakeCoin(txin.prevout);
+            AddStakeCoin(it->second, txin.prevout.n);
+        }
+    }
+}
+
+void CWallet::AvailableStakeCoins(std::vector<std::pair<const CWalletTx*, unsigned int>>& vCoins, int64_t nTime)
+{
+    AssertLockHeld(cs_wallet);
+    vCoins.clear();
+
+    if (!fStakeCoinsIndexed) {
+        for (const auto& entry : mapWallet) {
+            for (unsigned int i = 0; i < entry.second.tx->vout.size(); i++)
+                AddStakeCoin(entry.second, i);
+        }
+        fStakeCoinsIndexed = true;
+    }
+
+    while (!setStakeMaturing.empty() && setStakeMaturing.begin()->first <= nTime) {
+        setStakeEligible.insert(setStakeMaturing.begin()->second);
+        setStakeMaturing.erase(setStakeMaturing.begin());
+    }
+
+    // Depth is checked here rather than when a coin turns eligible, so a coin
+    // counts from the block it matures in and again after a reorganization.
+    const int nHeight = GetLastBlockHeight();
+    vCoins.reserve(setStakeEligible.size());
+    for (const COutPoint& outpoint : setStakeEligible) {
+        const StakeCoin& coin = mapStakeCoins.at(outpoint);
+        if (coin.nEligibleHeight > nHeight || IsLockedCoin(outpoint.hash, outpoint.n))
+            continue;
+        vCoins.emplace_back(coin.wtx, outpoint.n);
+    }
+}
+
 void CWallet::UpgradeKeyMetadata()
 {
     if (IsLocked() || IsWalletFlagSet(WALLET_FLAG_KEY_ORIGIN_METADATA)) {
@@ -880,6 +965,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // since AddToWallet is called directly for self-originating transactions, check for consumption of own coins
     WalletUpdateSpent(wtx.tx);
+    UpdateStakeCoins(wtx);
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1053,6 +1139,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             wtx.MarkDirty();
             batch.WriteTx(wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
+            UpdateStakeCoins(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
             while (iter != mapTxSpends.end() && iter->first.hash == now) {
@@ -1108,6 +1195,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, int conflicting_height, c
             wtx.setConflicted();
             wtx.MarkDirty();
             batch.WriteTx(wtx);
+            UpdateStakeCoins(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
             while (iter != mapTxSpends.end() && iter->first.hash == now) {
@@ -3228,6 +3316,11 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
         mapWallet.erase(it);
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
+    // The stake coin index points into mapWallet, rebuild it on next use
+    mapStakeCoins.clear();
+    setStakeMaturing.clear();
+    setStakeEligible.clear();
+    fStakeCoinsIndexed = false;
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
@@ -665,6 +665,9 @@ struct CoinSelectionParams
 };
 
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
+namespace wallet_tests {
+class StakeCoinsTestingSetup; // unit tests compare the stake coin index with a full scan
+} // namespace wallet_tests
 /**
  * A CWallet maintains a set of transactions and balances, and provides the ability to create new transactions.
  */
@@ -683,6 +686,7 @@ private:
     std::atomic<double> m_scanning_progress{0};
     std::mutex mutexScanning;
     friend class WalletRescanReserver;
+    friend class wallet_tests::StakeCoinsTestingSetup;
 
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion GUARDED_BY(cs_wallet){FEATURE_BASE};
@@ -727,6 +731,33 @@ private:
     /* Mark a transaction's inputs dirty, thus forcing the outputs to be recomputed */
     void MarkInputsDirty(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /** An output that may stake once it is nEligibleHeight deep and nEligibleTime old */
+    struct StakeCoin
+    {
+        const CWalletTx* wtx;
+        int nEligibleHeight;
+        int64_t nEligibleTime;
+    };
+
+    /**
+     * Index of the outputs that may stake: ours, spendable, confirmed,
+     * unspent and not a masternode collateral. Coins wait in
+     * setStakeMaturing, ordered by the time they become old enough, and
+     * move to setStakeEligible once they are; their depth is checked when
+     * the eligible coins are read. The index is built by the
+     * first AvailableStakeCoins() call and kept current by UpdateStakeCoins()
+     * instead of scanning mapWallet for every kernel search.
+     */
+    std::map<COutPoint, StakeCoin> mapStakeCoins GUARDED_BY(cs_wallet);
+    std::set<std::pair<int64_t, COutPoint>> setStakeMaturing GUARDED_BY(cs_wallet);
+    std::set<COutPoint> setStakeEligible GUARDED_BY(cs_wallet);
+    bool fStakeCoinsIndexed GUARDED_BY(cs_wallet){false};
+
+    void AddStakeCoin(const CWalletTx& wtx, unsigned int n) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RemoveStakeCoin(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* Re-evaluate a transaction's outputs and the wallet outputs it spends for staking */
+    void UpdateStakeCoins(const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /* Used by TransactionAddedToMemorypool/BlockConnected/Disconnected/ScanForWalletTransactions.
@@ -786,6 +817,9 @@ public:
     bool getStakingState();
     void setStakingFlag(bool status);
 
+    /** Outputs that can stake at nTime, taken from the stake coin index */
+    void AvailableStakeCoins(std::vector<std::pair<const CWalletTx*, unsigned int>>& vCoins, int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /** Get database handle used by this wallet. Ideally this function would
      * not be necessary.
      */